@@ -0,0 +1,451 @@
+/******************************************************************************
+
+ *  C code file   : asm.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Assembly instructions of a unit and their peephole optimization
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "asm.h"
+#include "intermediate.h"
+#include "output.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   ------------------------ Instructions -----------------------
+   ------------------------------------------------------------- */
+
+typedef enum {
+	A_LABEL,			//a label alone on its line
+	A_COMMENT,
+	A_MOV, A_LEA,
+	A_ADD, A_SUB, A_AND, A_OR, A_XOR, A_CMP, A_SHL,
+	A_IMUL, A_IDIV, A_CWD,
+	A_PUSH, A_POP,
+	A_CALL, A_RET, A_JMP, A_JCC,
+	A_OTHER				//proc, endp, int: nothing is known about it
+} AsmOp;
+
+static const struct { const char * name; AsmOp op; } mnemonics[] = {
+	{ "mov", A_MOV },	{ "lea", A_LEA },
+	{ "add", A_ADD },	{ "sub", A_SUB },	{ "and", A_AND },	{ "or", A_OR },
+	{ "xor", A_XOR },	{ "cmp", A_CMP },	{ "shl", A_SHL },
+	{ "imul", A_IMUL },	{ "idiv", A_IDIV },	{ "cwd", A_CWD },
+	{ "push", A_PUSH },	{ "pop", A_POP },
+	{ "call", A_CALL },	{ "ret", A_RET },	{ "jmp", A_JMP },
+	{ "je", A_JCC },	{ "jne", A_JCC },	{ "jl", A_JCC },	{ "jg", A_JCC },
+	{ "jle", A_JCC },	{ "jge", A_JCC },	{ "jnz", A_JCC },	{ "jz", A_JCC },
+};
+
+#define MNEMONIC_NUM	((int) (sizeof(mnemonics) / sizeof(mnemonics[0])))
+
+/* Registers as bits, a byte register as its word */
+#define R_AX	0x01
+#define R_BX	0x02
+#define R_CX	0x04
+#define R_DX	0x08
+#define R_SI	0x10
+#define R_DI	0x20
+#define R_BP	0x40
+#define R_SP	0x80
+
+static const struct { const char * name; unsigned bit; bool byte; } registers[] = {
+	{ "ax", R_AX, false },	{ "al", R_AX, true },	{ "ah", R_AX, true },
+	{ "bx", R_BX, false },	{ "bl", R_BX, true },	{ "bh", R_BX, true },
+	{ "cx", R_CX, false },	{ "cl", R_CX, true },	{ "ch", R_CX, true },
+	{ "dx", R_DX, false },	{ "dl", R_DX, true },	{ "dh", R_DX, true },
+	{ "si", R_SI, false },	{ "di", R_DI, false },	{ "bp", R_BP, false },	{ "sp", R_SP, false },
+};
+
+#define REGISTER_NUM	((int) (sizeof(registers) / sizeof(registers[0])))
+
+typedef enum {
+	ARG_NONE,
+	ARG_REG,
+	ARG_IMM,			//a number
+	ARG_MEM,			//byte ptr [bp-3], word ptr _next
+	ARG_OTHER			//labels, OFFSET
+} ArgKind;
+
+typedef struct {
+	ArgKind		kind;
+	int			text;			//in the pool, -1 for none
+	unsigned	regs;			//the register, or the registers of the address
+	bool		byte;			//8-bit register
+} AsmArg;
+
+typedef struct {
+	AsmOp		op;
+	bool		removed;
+	int			label;			//in the pool, -1 for none
+	bool		colon;
+	int			command;		//in the pool, -1 for none (a label or an empty line), the text of a comment
+	AsmArg		a[2];
+} AsmInstr;
+
+//the instructions of the unit, their strings in one pool (so they are indices: it grows)
+static AsmInstr *	list = NULL;
+static int			listNum = 0, listSize = 0;
+static char *		pool = NULL;
+static int			poolLen = 0, poolSize = 0;
+
+#define TEXT(T)		(pool + (T))
+
+static int poolStr(const char * s)
+{
+	int n, at = poolLen;
+	if (s == NULL) return -1;
+	n = strlen(s) + 1;
+	if (poolLen + n > poolSize) {
+		char * old = pool;
+		poolSize = 2 * (poolLen + n) + 1024;
+		pool = (char *) new(poolSize);
+		if (old != NULL) {
+			memcpy(pool, old, poolLen);
+			delete(old);
+		}
+	}
+	memcpy(pool + poolLen, s, n);
+	poolLen += n;
+	return at;
+}
+
+static int findRegister(const char * s, int len)
+{
+	int i;
+	for (i = 0; i < REGISTER_NUM; i++)
+		if ((int) strlen(registers[i].name) == len && !strncmp(registers[i].name, s, len)) return i;
+	return -1;
+}
+
+static AsmArg newArg(const char * s)
+{
+	AsmArg a = { ARG_NONE, -1, 0, false };
+	int r, n;
+	if (s == NULL) return a;
+	a.text = poolStr(s);
+	if ((r = findRegister(s, strlen(s))) >= 0) {
+		a.kind = ARG_REG;
+		a.regs = registers[r].bit;
+		a.byte = registers[r].byte;
+	}
+	else if (isdigit((unsigned char) s[0]) || s[0] == '-')
+		a.kind = ARG_IMM;
+	else if (strchr(s, '[') != NULL || strstr(s, " ptr ") != NULL) {
+		a.kind = ARG_MEM;
+		for (s = strchr(s, '['); s != NULL && *s != '\0'; s += n) {	//whole words inside the brackets
+			for (n = 0; isalnum((unsigned char) s[n]) || s[n] == '_'; n++) ;
+			if (n == 0) n = 1;
+			else if ((r = findRegister(s, n)) >= 0) a.regs |= registers[r].bit;
+		}
+	}
+	else
+		a.kind = ARG_OTHER;
+	return a;
+}
+
+static AsmOp opOf(const char * command)
+{
+	int i;
+	if (command == NULL) return A_LABEL;
+	for (i = 0; i < MNEMONIC_NUM; i++)
+		if (!strcmp(mnemonics[i].name, command)) return mnemonics[i].op;
+	return A_OTHER;
+}
+
+static AsmInstr * append()
+{
+	if (listNum == listSize) {
+		AsmInstr * old = list;
+		listSize = 2 * listSize + 256;
+		list = (AsmInstr *) new(listSize * sizeof(AsmInstr));
+		if (old != NULL) {
+			memcpy(list, old, listNum * sizeof(AsmInstr));
+			delete(old);
+		}
+	}
+	return &list[listNum++];
+}
+
+void asmCode(const char * label, bool colon, const char * command, const char * a1, const char * a2)
+{
+	AsmInstr * in = append();
+	in->op		= opOf(command);
+	in->removed	= false;
+	in->label	= poolStr(label);
+	in->colon	= colon;
+	in->command	= poolStr(command);
+	in->a[0]	= newArg(a1);
+	in->a[1]	= newArg(a2);
+}
+
+void asmComment(const char * text)
+{
+	AsmInstr * in = append();
+	in->op		= A_COMMENT;
+	in->removed	= false;
+	in->label	= -1;
+	in->colon	= false;
+	in->command	= poolStr(text);
+	in->a[0]	= newArg(NULL);
+	in->a[1]	= newArg(NULL);
+}
+
+
+/* -------------------------------------------------------------
+   -------------------- Reads and writes -----------------------
+   ------------------------------------------------------------- */
+
+static unsigned regsOf(AsmArg a)	{ return (a.kind == ARG_REG || a.kind == ARG_MEM) ? a.regs : 0; }
+
+//the registers an instruction may read: a write to a byte register reads the rest of its word
+static unsigned reads(AsmInstr * in)
+{
+	switch (in->op) {
+		case A_MOV: case A_LEA:
+			return (in->a[0].kind == ARG_MEM || in->a[0].byte ? regsOf(in->a[0]) : 0) | regsOf(in->a[1]);
+		case A_ADD: case A_SUB: case A_AND: case A_OR: case A_XOR: case A_CMP: case A_SHL:
+			return regsOf(in->a[0]) | regsOf(in->a[1]);
+		case A_IMUL:	return R_AX | regsOf(in->a[0]);
+		case A_IDIV:	return R_AX | R_DX | regsOf(in->a[0]);
+		case A_CWD:		return R_AX;
+		case A_PUSH:	return R_SP | regsOf(in->a[0]);
+		default:		return ~0U;
+	}
+}
+
+//the registers it writes as a whole, without reading them first
+static unsigned writes(AsmInstr * in)
+{
+	switch (in->op) {
+		case A_MOV: case A_LEA:
+			return (in->a[0].kind == ARG_REG && !in->a[0].byte) ? in->a[0].regs : 0;
+		case A_IMUL: case A_IDIV:	return R_AX | R_DX;
+		case A_CWD:					return R_DX;
+		default:					return 0;
+	}
+}
+
+static bool writesFlags(AsmInstr * in)
+{
+	switch (in->op) {
+		case A_ADD: case A_SUB: case A_AND: case A_OR: case A_XOR: case A_CMP: case A_SHL:
+		case A_IMUL: case A_IDIV:
+		case A_CALL: case A_RET:	//no flags across calls
+			return true;
+		default:
+			return false;
+	}
+}
+
+//a jump or a label ends what the rules may look at: the flags and registers are unknown after it
+static bool barrier(AsmInstr * in)
+{
+	return in->label >= 0 || in->op == A_LABEL || in->op == A_JMP || in->op == A_JCC || in->op == A_RET || in->op == A_CALL || in->op == A_OTHER;
+}
+
+//the next instruction after list[i] that is printed, -1 at the end of the list
+static int next(int i)
+{
+	for (i++; i < listNum; i++)
+		if (!list[i].removed && list[i].op != A_COMMENT) return i;
+	return -1;
+}
+
+//the next one, if no label comes first (so both always run together)
+static int follows(int i)
+{
+	int j = next(i);
+	return (j < 0 || list[j].label >= 0 || list[j].op == A_LABEL) ? -1 : j;
+}
+
+static bool sameText(AsmArg a, AsmArg b)	{ return a.text >= 0 && b.text >= 0 && !strcmp(TEXT(a.text), TEXT(b.text)); }
+
+static bool isSp(AsmArg a)	{ return a.kind == ARG_REG && a.regs == R_SP; }
+
+static void removeInstr(int i)
+{
+	if (list[i].label < 0) {
+		list[i].removed = true;
+		return;
+	}
+	list[i].op		= A_LABEL;	//the label stays
+	list[i].command	= -1;
+	list[i].a[0]	= newArg(NULL);
+	list[i].a[1]	= newArg(NULL);
+}
+
+
+/* -------------------------------------------------------------
+   --------------------------- Rules ---------------------------
+   ------------------------------------------------------------- */
+
+/* mov M, r
+ * mov r2, M	-> mov r2, r (nothing if r2 is r) */
+static bool rule_reload(int i)
+{
+	int j = follows(i);
+	if (list[i].op != A_MOV || list[i].a[0].kind != ARG_MEM || list[i].a[1].kind != ARG_REG) return false;
+	if (j < 0 || list[j].op != A_MOV || list[j].a[0].kind != ARG_REG || !sameText(list[i].a[0], list[j].a[1])) return false;
+	if (sameText(list[i].a[1], list[j].a[0]))	removeInstr(j);
+	else										list[j].a[1] = list[i].a[1];
+	return true;
+}
+
+/* mov r, x that no one reads before r is written again (mov r, r at once) */
+static bool rule_deadMove(int i)
+{
+	unsigned r = list[i].a[0].regs;
+	int j;
+	if ((list[i].op != A_MOV && list[i].op != A_LEA) || list[i].a[0].kind != ARG_REG || list[i].a[0].byte) return false;
+	if (r == R_SP || r == R_BP) return false;
+	if (list[i].op == A_MOV && sameText(list[i].a[0], list[i].a[1])) {
+		removeInstr(i);
+		return true;
+	}
+	for (j = follows(i); j >= 0; j = follows(j)) {
+		if (reads(&list[j]) & r) return false;
+		if (writes(&list[j]) & r) {
+			removeInstr(i);
+			return true;
+		}
+		if (barrier(&list[j])) return false;
+	}
+	return false;
+}
+
+//the stack pointer by a constant: add sp, N is N, sub sp, N is -N
+static bool spAdjust(int i, int * n)
+{
+	if ((list[i].op != A_ADD && list[i].op != A_SUB) || !isSp(list[i].a[0]) || list[i].a[1].kind != ARG_IMM) return false;
+	*n = atoi(TEXT(list[i].a[1].text));
+	if (list[i].op == A_SUB) *n = - *n;
+	return true;
+}
+
+/* add sp, N
+ * sub sp, M	-> add sp, N-M (the flags of either are never tested) */
+static bool rule_mergeSp(int i)
+{
+	int j = follows(i), n, m, k;
+	char buf[16];
+	if (j < 0 || !spAdjust(i, &n) || !spAdjust(j, &m)) return false;
+	if ((k = follows(j)) >= 0 && list[k].op == A_JCC) return false;
+	removeInstr(j);
+	if (n + m == 0) {
+		removeInstr(i);
+		return true;
+	}
+	list[i].command = poolStr((n + m > 0) ? "add" : "sub");
+	list[i].op = (n + m > 0) ? A_ADD : A_SUB;
+	snprintf(buf, sizeof(buf), "%d", abs(n + m));
+	list[i].a[1] = newArg(buf);
+	return true;
+}
+
+/* mov r, 0	-> xor r, r (two bytes shorter), if the flags are written before they are tested */
+static bool rule_xorZero(int i)
+{
+	int j;
+	if (list[i].op != A_MOV || list[i].a[0].kind != ARG_REG || list[i].a[1].kind != ARG_IMM || strcmp(TEXT(list[i].a[1].text), "0")) return false;
+	for (j = follows(i); j >= 0 && !writesFlags(&list[j]); j = follows(j))
+		if (barrier(&list[j])) return false;
+	if (j < 0) return false;
+	list[i].op = A_XOR;
+	list[i].command = poolStr("xor");
+	list[i].a[1] = list[i].a[0];
+	return true;
+}
+
+/* The rules try every instruction in turn, until none of them changes anything. Every rule
+ * returns whether it changed some instruction */
+typedef struct Rule_tag {
+	const char *	name;			//for -fno-<name>
+	bool			(*apply)(int i);
+	bool			enabled;
+} Rule;
+
+static Rule rules[] = {
+	{ "reload",		rule_reload,	true },
+	{ "deadmov",	rule_deadMove,	true },	//after reload: what it leaves may be dead
+	{ "spmerge",	rule_mergeSp,	true },
+	{ "xorzero",	rule_xorZero,	true },	//last: a xor is no longer a mov for the rest
+};
+
+#define RULE_NUM	((int) (sizeof(rules) / sizeof(Rule)))
+
+bool disableRule(const char * name)
+{
+	int i;
+	for (i = 0; i < RULE_NUM; i++)
+		if (!strcmp(rules[i].name, name)) {
+			rules[i].enabled = false;
+			return true;
+		}
+	return false;
+}
+
+static void peephole()
+{
+	bool changed = true;
+	int i, r;
+	#ifdef DEBUG
+	int before = 0, after = 0;
+	for (i = 0; i < listNum; i++) if (list[i].op != A_COMMENT && list[i].op != A_LABEL) before++;
+	#endif
+	while (changed) {
+		changed = false;
+		for (r = 0; r < RULE_NUM; r++) {
+			if (!rules[r].enabled) continue;
+			for (i = 0; i < listNum; i++)
+				if (!list[i].removed && list[i].op != A_COMMENT && rules[r].apply(i)) changed = true;
+		}
+	}
+	#ifdef DEBUG
+	for (i = 0; i < listNum; i++) if (!list[i].removed && list[i].op != A_COMMENT && list[i].op != A_LABEL) after++;
+	printf("peephole: %d instructions instead of %d\n", after, before);
+	#endif
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Printing --------------------------
+   ------------------------------------------------------------- */
+
+void asmFlush()
+{
+	int i;
+	if (getOptLevel() > 0) peephole();
+	for (i = 0; i < listNum; i++) {
+		AsmInstr * in = &list[i];
+		if (in->removed) continue;
+		if (in->op == A_COMMENT) {
+			outStr(asmOut, TEXT(in->command));
+			outChar(asmOut, '\n');
+			continue;
+		}
+		if (in->label >= 0)			outStr(asmOut, TEXT(in->label));
+		if (in->colon)				outChar(asmOut, ':');
+		if (in->command >= 0)		{outChar(asmOut, '\t');	outStr(asmOut, TEXT(in->command));}
+		if (in->a[0].text >= 0)		{outChar(asmOut, '\t');	outStr(asmOut, TEXT(in->a[0].text));}
+		if (in->a[1].text >= 0)		{outStr(asmOut, ", ");	outStr(asmOut, TEXT(in->a[1].text));}
+		outChar(asmOut, '\n');
+	}
+	listNum = 0;
+	poolLen = 0;
+}
@@ -0,0 +1,35 @@
+/******************************************************************************
+ *
+ *  C header file : asm.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Assembly instructions of a unit and their peephole optimization
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __ASM_H__
+#define __ASM_H__
+
+#include <stdbool.h>
+
+/* final.c does not print its instructions, it appends them here (the command, its operands
+ * and a label in front, as they would be printed). Each operand becomes a record (register,
+ * immediate, memory and the registers of its address), so after the unit is over the rules
+ * of the peephole optimizer can look at what the instructions read and write. Then the
+ * list is printed to asmOut and starts over */
+
+void	asmCode		(const char * label, bool colon, const char * command, const char * a1, const char * a2);
+void	asmComment	(const char * text);	/* ;;; a line of its own */
+void	asmFlush	(void);					/* the rules (from -O1) and printing */
+
+bool	disableRule	(const char * name);	/* -fno-<name>, returns false if there is no such rule */
+
+#endif
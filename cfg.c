@@ -0,0 +1,297 @@
+/******************************************************************************
+
+ *  C code file   : cfg.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Basic blocks and control flow graph of the quads of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "cfg.h"
+#include "intermediate.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   ------------------------- Functions -------------------------
+   ------------------------------------------------------------- */
+
+int unitEnd(int first)
+{
+	int i;
+	if (q[first].op != O_UNIT) internal("unitEnd: quad %d is not an O_UNIT", first);
+	for (i = first + 1; i < quadNext; i++)
+		if (q[i].op == O_ENDU) return i;
+	internal("unitEnd: unit of quad %d has no O_ENDU", first);
+	return -1;
+}
+
+int jumpTarget(int i)
+{
+	if (!ISJUMP(q[i].op) || q[i].z->type != OPERAND_QLABEL) return -1;	//a list not backpatched yet keeps its *
+	return q[i].z->u.quadLabel;
+}
+
+int lastActive(Block * b)
+{
+	int i;
+	for (i = b->last; i >= b->first; i--)
+		if (ISACTIVE(q[i].num)) return i;
+	return -1;
+}
+
+static void addEdge(Cfg g, int from, int slot, int to)
+{
+	Block * b = &(g->block[from]);
+	if (to < 0) return;
+	if (slot == 1 && b->succ[0] == to) return;	//branch to the next quad
+	b->succ[slot] = to;
+	g->block[to].predNum++;
+}
+
+Cfg buildCfg(int first, int last)
+{
+	int n = last - first + 1;
+	int i, t, b, total;
+	Cfg g = (Cfg) new(sizeof(struct Cfg_tag));
+	g->first	= first;
+	g->last		= last;
+	g->blockOf	= (int *) new(n * sizeof(int));
+	g->rpo		= NULL;
+	g->rpoIndex	= NULL;
+	g->rpoNum	= 0;
+
+	/* 1. leaders, marked temporarily in blockOf */
+	for (i = 0; i < n; i++) g->blockOf[i] = 0;
+	g->blockOf[0] = 1;
+	g->blockOf[1] = 1;
+	g->blockOf[n - 1] = 1;
+	for (i = first + 1; i < last; i++) {
+		if (!ISACTIVE(q[i].num)) continue;
+		if (ISJUMP(q[i].op) || q[i].op == O_RET)
+			g->blockOf[i + 1 - first] = 1;
+		t = jumpTarget(i);
+		if (t >= 0) {
+			if (t <= first || t > last) internal("buildCfg: quad %d jumps out of its unit", i);
+			g->blockOf[t - first] = 1;
+		}
+	}
+
+	/* 2. blocks and the block of every quad */
+	g->blockNum = 0;
+	for (i = 0; i < n; i++)
+		if (g->blockOf[i]) g->blockNum++;
+	g->block = (Block *) new(g->blockNum * sizeof(Block));
+	b = -1;
+	for (i = 0; i < n; i++) {
+		if (g->blockOf[i]) {
+			b++;
+			g->block[b].first		= first + i;
+			g->block[b].succ[0]		= -1;
+			g->block[b].succ[1]		= -1;
+			g->block[b].predNum		= 0;
+			g->block[b].reachable	= false;
+			g->block[b].idom		= -1;
+		}
+		g->blockOf[i] = b;
+		g->block[b].last = first + i;
+	}
+
+	/* 3. successors, from the last quad of every block */
+	for (b = 0; b < g->blockNum - 1; b++) {
+		i = lastActive(&(g->block[b]));
+		if (i < 0) { addEdge(g, b, 0, b + 1); continue; }
+		t = jumpTarget(i);
+		switch (q[i].op) {
+			case O_JUMP:	if (t >= 0) addEdge(g, b, 0, BLOCK_OF(g, t));		break;
+			case O_RET:		addEdge(g, b, 0, g->blockNum - 1);					break;
+			default:
+				addEdge(g, b, 0, b + 1);
+				if (t >= 0) addEdge(g, b, 1, BLOCK_OF(g, t));
+				break;
+		}
+	}
+
+	/* 4. predecessors, all in one array */
+	total = 0;
+	for (b = 0; b < g->blockNum; b++) total += g->block[b].predNum;
+	int * preds = (int *) new((total + 1) * sizeof(int));
+	for (b = 0; b < g->blockNum; b++) {
+		g->block[b].pred = preds;
+		preds += g->block[b].predNum;
+		g->block[b].predNum = 0;
+	}
+	for (b = 0; b < g->blockNum; b++)
+		for (i = 0; i < 2; i++) {
+			t = g->block[b].succ[i];
+			if (t >= 0) g->block[t].pred[g->block[t].predNum++] = b;
+		}
+
+	/* 5. reachability from the entry, depth first */
+	int * stack = (int *) new(g->blockNum * sizeof(int));
+	int top = 0;
+	stack[top++] = 0;
+	g->block[0].reachable = true;
+	while (top > 0) {
+		b = stack[--top];
+		for (i = 0; i < 2; i++) {
+			t = g->block[b].succ[i];
+			if (t >= 0 && !g->block[t].reachable) {
+				g->block[t].reachable = true;
+				stack[top++] = t;
+			}
+		}
+	}
+	delete(stack);
+
+	#ifdef DEBUG
+	printCfg(g);
+	#endif
+	return g;
+}
+
+void deleteCfg(Cfg g)
+{
+	if (g == NULL) return;
+	delete(g->block[0].pred);	//start of the array of all predecessors
+	delete(g->block);
+	delete(g->blockOf);
+	delete(g->rpo);
+	delete(g->rpoIndex);
+	delete(g);
+}
+
+/* Code after exit/return and dead else arms. The O_ENDU always stays, even if the unit
+ * never ends (infinite loop), since the procedure has to be closed.
+ * Unreachable blocks are dropped from the predecessors of the reachable ones, so that
+ * the graph remains valid for the passes that follow */
+int removeUnreachable(Cfg g)
+{
+	int b, i, k, removed = 0;
+	for (b = 1; b < g->blockNum - 1; b++) {
+		if (g->block[b].reachable) continue;
+		for (i = g->block[b].first; i <= g->block[b].last; i++)
+			if (ISACTIVE(q[i].num)) {
+				q[i].num = -1;
+				removed++;
+			}
+		#ifdef DEBUG
+		printf("cfg: block %d (quads %d-%d) is unreachable, removed\n", b, g->block[b].first, g->block[b].last);
+		#endif
+	}
+	for (b = 0; b < g->blockNum; b++) {
+		Block * p = &(g->block[b]);
+		for (i = k = 0; i < p->predNum; i++)
+			if (g->block[p->pred[i]].reachable) p->pred[k++] = p->pred[i];
+		p->predNum = k;
+	}
+	return removed;
+}
+
+/* Reverse postorder by an iterative depth first search: next[b] is the successor of b to visit next */
+static void computeRpo(Cfg g)
+{
+	int b, t, top = 0, post;
+	int * stack = (int *) new(g->blockNum * sizeof(int));
+	int * next  = (int *) new(g->blockNum * sizeof(int));
+	delete(g->rpo);
+	delete(g->rpoIndex);
+	g->rpo		= (int *) new(g->blockNum * sizeof(int));
+	g->rpoIndex	= (int *) new(g->blockNum * sizeof(int));
+	for (b = 0; b < g->blockNum; b++) {
+		g->rpoIndex[b] = -1;
+		next[b] = 0;
+	}
+	post = g->blockNum;
+	stack[top++] = 0;
+	g->rpoIndex[0] = 0;		//visited
+	while (top > 0) {
+		b = stack[top - 1];
+		if (next[b] < 2) {
+			t = g->block[b].succ[next[b]++];
+			if (t >= 0 && g->rpoIndex[t] < 0) {
+				g->rpoIndex[t] = 0;
+				stack[top++] = t;
+			}
+			continue;
+		}
+		g->rpo[--post] = b;
+		top--;
+	}
+	//the reachable blocks are at the end of rpo
+	g->rpoNum = g->blockNum - post;
+	for (b = 0; b < g->rpoNum; b++) {
+		g->rpo[b] = g->rpo[post + b];
+		g->rpoIndex[g->rpo[b]] = b;
+	}
+	delete(stack);
+	delete(next);
+}
+
+static int intersect(Cfg g, int b1, int b2)
+{
+	while (b1 != b2) {
+		while (g->rpoIndex[b1] > g->rpoIndex[b2]) b1 = g->block[b1].idom;
+		while (g->rpoIndex[b2] > g->rpoIndex[b1]) b2 = g->block[b2].idom;
+	}
+	return b1;
+}
+
+/* Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm": iterates over the blocks
+ * in reverse postorder, each one is dominated by the common dominator of its predecessors */
+void computeDominators(Cfg g)
+{
+	int b, k, i, d;
+	bool changed = true;
+	computeRpo(g);
+	for (b = 0; b < g->blockNum; b++) g->block[b].idom = -1;
+	g->block[0].idom = 0;
+	while (changed) {
+		changed = false;
+		for (k = 1; k < g->rpoNum; k++) {
+			Block * p = &(g->block[g->rpo[k]]);
+			d = -1;
+			for (i = 0; i < p->predNum; i++) {
+				if (g->block[p->pred[i]].idom < 0) continue;	//not processed yet or unreachable
+				d = (d < 0) ? p->pred[i] : intersect(g, p->pred[i], d);
+			}
+			if (d != p->idom) {
+				p->idom = d;
+				changed = true;
+			}
+		}
+	}
+	g->block[0].idom = -1;
+}
+
+bool dominates(Cfg g, int a, int b)
+{
+	if (g->rpoIndex == NULL || g->rpoIndex[a] < 0 || g->rpoIndex[b] < 0) return false;
+	while (b >= 0 && g->rpoIndex[b] > g->rpoIndex[a]) b = g->block[b].idom;
+	return b == a;
+}
+
+#ifdef DEBUG
+void printCfg(Cfg g)
+{
+	int b, i;
+	printf("cfg: unit of quads %d-%d, %d blocks\n", g->first, g->last, g->blockNum);
+	for (b = 0; b < g->blockNum; b++) {
+		Block * p = &(g->block[b]);
+		printf("  block %d: quads %d-%d, succ %d %d, pred", b, p->first, p->last, p->succ[0], p->succ[1]);
+		for (i = 0; i < p->predNum; i++) printf(" %d", p->pred[i]);
+		printf("%s\n", p->reachable ? "" : " (unreachable)");
+	}
+}
+#endif
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ *  C header file : cfg.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Basic blocks and control flow graph of the quads of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __CFG_H__
+#define __CFG_H__
+
+#include <stdbool.h>
+
+#include "intermediate.h"
+
+/* A unit is the range of quads from its O_UNIT to its O_ENDU. Nested units always end
+ * before the quads of the enclosing unit start, so the units of q never overlap.
+ * Leaders are the O_UNIT, the quad after it, the targets of O_JUMP, O_IFB and the relational
+ * quads, the quads that follow them or an O_RET, and the O_ENDU. So the first block of a
+ * unit (entry) contains only its O_UNIT and the last one (exit) only its O_ENDU.
+ * Removed quads (num < 0) stay inside the blocks and are skipped by the passes. */
+
+//quads that may jump to their z operand
+#define ISRELOP(OP)		((OP) >= O_EQ && (OP) <= O_GE)
+#define ISBRANCH(OP)	(ISRELOP(OP) || (OP) == O_IFB)
+#define ISJUMP(OP)		(ISBRANCH(OP) || (OP) == O_JUMP)
+
+/* ---------------------------------------------------------------------
+   --------------------------- Ορισμός τύπων ---------------------------
+   --------------------------------------------------------------------- */
+
+typedef struct Block_tag {
+	int		first;		//leader of the block
+	int		last;		//last quad of the block (it may have been removed)
+	int		succ[2];	//[0]: fall through or target of O_JUMP/O_RET, [1]: target of a branch, -1 if none
+	int *	pred;		//predecessor blocks
+	int		predNum;
+	bool	reachable;	//from the entry of the unit
+	int		idom;		//immediate dominator, -1 for the entry and the unreachable blocks (computeDominators)
+} Block;
+
+typedef struct Cfg_tag {
+	int		first;		//O_UNIT quad of the unit
+	int		last;		//O_ENDU quad of the unit
+	int		blockNum;
+	Block *	block;		//block[0] is the entry, block[blockNum-1] the exit
+	int *	blockOf;	//blockOf[i - first]: the block of quad i
+	int *	rpo;		//reachable blocks in reverse postorder, NULL until computeDominators
+	int *	rpoIndex;	//rpoIndex[b]: position of block b in rpo, -1 if unreachable
+	int		rpoNum;
+} * Cfg;
+
+/* ---------------------------------------------------------------------
+   --------------- Πρωτότυπα των βοηθητικών συναρτήσεων ----------------
+   --------------------------------------------------------------------- */
+
+int		unitEnd			(int first);	/* O_ENDU quad of the unit whose O_UNIT is q[first] */
+int		jumpTarget		(int i);		/* quad that q[i] may jump to, -1 if none */
+int		lastActive		(Block * b);	/* last quad of the block not removed, -1 if none */
+
+Cfg		buildCfg		(int first, int last);
+void	deleteCfg		(Cfg g);
+int		removeUnreachable	(Cfg g);	/* removes the quads of unreachable blocks, returns their number */
+void	computeDominators	(Cfg g);	/* fills rpo and Block::idom */
+bool	dominates		(Cfg g, int a, int b);	/* whether block a dominates block b */
+
+#define BLOCK_OF(G,I)	((G)->blockOf[(I) - (G)->first])
+
+#ifdef DEBUG
+void	printCfg		(Cfg g);
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+/******************************************************************************
+
+ *  C code file   : dataflow.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Dataflow analyses over the control flow graph of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dataflow.h"
+#include "cfg.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   -------------------------- Sets -----------------------------
+   ------------------------------------------------------------- */
+
+Set newSet(Flow f)
+{
+	Set s = (Set) new(f->words * sizeof(unsigned long));
+	memset(s, 0, f->words * sizeof(unsigned long));
+	return s;
+}
+
+void setCopy(Flow f, Set to, Set from)
+{
+	memcpy(to, from, f->words * sizeof(unsigned long));
+}
+
+bool setUnion(Flow f, Set to, Set from)
+{
+	int i;
+	bool changed = false;
+	for (i = 0; i < f->words; i++)
+		if ((to[i] | from[i]) != to[i]) {
+			to[i] |= from[i];
+			changed = true;
+		}
+	return changed;
+}
+
+
+/* -------------------------------------------------------------
+   ---------------------- Tracked symbols ----------------------
+   ------------------------------------------------------------- */
+
+static bool isLocal(Flow f, SymbolEntry * s)
+{
+	if (s->nestingLevel != f->level) return false;
+	switch (s->entryType) {
+		case ENTRY_VARIABLE:
+		case ENTRY_TEMPORARY:	return true;
+		case ENTRY_PARAMETER:	return s->u.eParameter.mode == PASS_BY_VALUE;
+		default:				return false;
+	}
+}
+
+static void number(Flow f, Operand o, int * size)
+{
+	SymbolEntry * s = getSymbol(o);
+	if (s == NULL || o->type == OPERAND_UNIT || s->flowIndex >= 0 || !isLocal(f, s)) return;
+	if (f->symNum == *size) {
+		*size *= 2;
+		f->sym = (SymbolEntry **) realloc(f->sym, *size * sizeof(SymbolEntry *));
+		if (f->sym == NULL) fatal("Out of memory");
+	}
+	s->flowIndex = f->symNum;
+	f->sym[f->symNum++] = s;
+}
+
+Flow newFlow(Cfg g)
+{
+	int i, size = 64;
+	Flow f = (Flow) new(sizeof(struct Flow_tag));
+	f->g		= g;
+	f->level	= getSymbol(q[g->first].x)->nestingLevel + 1;
+	f->symNum	= 0;
+	f->sym		= (SymbolEntry **) new(size * sizeof(SymbolEntry *));
+	f->liveIn	= NULL;
+	f->liveOut	= NULL;
+	for (i = g->first + 1; i < g->last; i++) {
+		if (!ISACTIVE(q[i].num)) continue;
+		number(f, q[i].x, &size);
+		number(f, q[i].y, &size);
+		number(f, q[i].z, &size);
+	}
+	f->words = (f->symNum + SET_BITS - 1) / SET_BITS + 1;
+	f->vars = newSet(f);
+	for (i = 0; i < f->symNum; i++)
+		if (f->sym[i]->entryType != ENTRY_TEMPORARY) SET_ADD(f->vars, i);
+	#ifdef DEBUG
+	printf("dataflow: unit of quads %d-%d, %d tracked symbols\n", g->first, g->last, f->symNum);
+	#endif
+	return f;
+}
+
+void deleteFlow(Flow f)
+{
+	int i;
+	if (f == NULL) return;
+	for (i = 0; i < f->symNum; i++) f->sym[i]->flowIndex = -1;
+	if (f->liveIn != NULL)
+		for (i = 0; i < f->g->blockNum; i++) {
+			delete(f->liveIn[i]);
+			delete(f->liveOut[i]);
+		}
+	delete(f->liveIn);
+	delete(f->liveOut);
+	delete(f->vars);
+	delete(f->sym);
+	delete(f);
+}
+
+int flowIndex(Flow f, Operand o)
+{
+	SymbolEntry * s = getSymbol(o);
+	if (s == NULL || o->type == OPERAND_UNIT) return -1;
+	return s->flowIndex;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Liveness --------------------------
+   ------------------------------------------------------------- */
+
+/* Only a plain symbol operand in the place of the result is defined. In [x] := ... x is read.
+ * The result of a function (par x, RET) is written by the call that follows */
+int quadDef(Flow f, int i)
+{
+	switch (q[i].op) {
+		case O_ASSIGN: case O_ARRAY:
+		case O_ADD: case O_SUB: case O_MULT: case O_DIV: case O_MOD:
+			return q[i].z->type == OPERAND_SYMBOL ? flowIndex(f, q[i].z) : -1;
+		case O_PAR:
+			return (q[i].y == oRET && q[i].x->type == OPERAND_SYMBOL) ? flowIndex(f, q[i].x) : -1;
+		default:
+			return -1;
+	}
+}
+
+static void use(Flow f, Operand o, Set live)
+{
+	int k = flowIndex(f, o);
+	if (k >= 0) SET_ADD(live, k);
+}
+
+void liveStep(Flow f, int i, Set live)
+{
+	int k, d;
+	if (!ISACTIVE(q[i].num)) return;
+	d = quadDef(f, i);
+	if (d >= 0) SET_DEL(live, d);
+	switch (q[i].op) {
+		case O_UNIT: case O_ENDU: case O_JUMP: case O_RET:
+			break;
+		case O_CALL:
+			for (k = 0; k < f->words; k++) live[k] |= f->vars[k];
+			break;
+		case O_PAR:
+			if (d < 0) use(f, q[i].x, live);
+			break;
+		default:
+			use(f, q[i].x, live);
+			use(f, q[i].y, live);
+			if (q[i].z->type == OPERAND_DEREFERENCE) use(f, q[i].z, live);
+			break;
+	}
+}
+
+/* Backwards, until nothing changes. The transfer function of every block is computed once,
+ * as its upward exposed uses (gen) and its definitions (kill) */
+void computeLiveness(Flow f)
+{
+	Cfg g = f->g;
+	int b, i, k;
+	Set * gen  = (Set *) new(g->blockNum * sizeof(Set));
+	Set * kill = (Set *) new(g->blockNum * sizeof(Set));
+	f->liveIn  = (Set *) new(g->blockNum * sizeof(Set));
+	f->liveOut = (Set *) new(g->blockNum * sizeof(Set));
+	for (b = 0; b < g->blockNum; b++) {
+		f->liveIn[b]  = newSet(f);
+		f->liveOut[b] = newSet(f);
+		gen[b]  = newSet(f);
+		kill[b] = newSet(f);
+		for (i = g->block[b].last; i >= g->block[b].first; i--) {
+			if (!ISACTIVE(q[i].num)) continue;
+			int d = quadDef(f, i);
+			if (d >= 0) SET_ADD(kill[b], d);
+			liveStep(f, i, gen[b]);
+		}
+	}
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (b = g->blockNum - 1; b >= 0; b--) {
+			Block * p = &(g->block[b]);
+			if (!p->reachable) continue;
+			for (i = 0; i < 2; i++)
+				if (p->succ[i] >= 0) setUnion(f, f->liveOut[b], f->liveIn[p->succ[i]]);
+			for (k = 0; k < f->words; k++) {
+				unsigned long in = gen[b][k] | (f->liveOut[b][k] & ~kill[b][k]);
+				if (in != f->liveIn[b][k]) {
+					f->liveIn[b][k] = in;
+					changed = true;
+				}
+			}
+		}
+	}
+	for (b = 0; b < g->blockNum; b++) {
+		delete(gen[b]);
+		delete(kill[b]);
+	}
+	delete(gen);
+	delete(kill);
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ *  C header file : dataflow.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Dataflow analyses over the control flow graph of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __DATAFLOW_H__
+#define __DATAFLOW_H__
+
+#include <stdbool.h>
+
+#include "symbol.h"
+#include "intermediate.h"
+#include "cfg.h"
+
+/* The analyses track the locals of a unit: its variables, its parameters passed by value and
+ * its temporaries. Each one gets a number (SymbolEntry::flowIndex) in the sets.
+ * Everything else (non-locals, parameters passed by reference, the targets of [x] and $$)
+ * is memory and is never assumed dead.
+ * A nested function may read the variables of the unit, so a call uses all of them. */
+
+/* ---------------------------------------------------------------------
+   --------------------------- Ορισμός τύπων ---------------------------
+   --------------------------------------------------------------------- */
+
+/* Sets of tracked symbols, as bit vectors of Flow::words words */
+typedef unsigned long * Set;
+
+#define SET_BITS		(8 * sizeof(unsigned long))
+#define SET_HAS(S,K)	(((S)[(K) / SET_BITS] >> ((K) % SET_BITS)) & 1UL)
+#define SET_ADD(S,K)	((S)[(K) / SET_BITS] |= 1UL << ((K) % SET_BITS))
+#define SET_DEL(S,K)	((S)[(K) / SET_BITS] &= ~(1UL << ((K) % SET_BITS)))
+
+typedef struct Flow_tag {
+	Cfg				g;
+	unsigned int	level;		//nesting level of the locals of the unit
+	int				symNum;		//number of tracked symbols
+	SymbolEntry **	sym;		//sym[k]: the symbol with flowIndex k
+	int				words;		//words of every Set
+	Set				vars;		//tracked variables and parameters (not temporaries)
+	Set *			liveIn;		//per block, filled by computeLiveness()
+	Set *			liveOut;
+} * Flow;
+
+/* ---------------------------------------------------------------------
+   --------------- Πρωτότυπα των βοηθητικών συναρτήσεων ----------------
+   --------------------------------------------------------------------- */
+
+Flow	newFlow			(Cfg g);		/* numbers the locals of the unit of g */
+void	deleteFlow		(Flow f);		/* symbols get back flowIndex -1 */
+
+Set		newSet			(Flow f);		/* empty set */
+void	setCopy			(Flow f, Set to, Set from);
+bool	setUnion		(Flow f, Set to, Set from);	/* returns whether to changed */
+
+int		flowIndex		(Flow f, Operand o);	/* tracked symbol written or read as o, -1 if none */
+int		quadDef			(Flow f, int i);		/* tracked symbol defined by q[i], -1 if none */
+void	liveStep		(Flow f, int i, Set live);	/* live after q[i] -> live before q[i] */
+void	computeLiveness	(Flow f);
+
+#endif
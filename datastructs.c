@@ -19,6 +19,24 @@
 #include "general.h"
 #include "error.h"
 
+/* Nodes removed from queues are kept in a free list and reused, instead of being freed */
+static genNode * freeNodes = NULL;
+
+static genNode * newNode()
+{
+	genNode * n = freeNodes;
+	if(n==NULL) return (genNode *) new(sizeof(genNode));
+	freeNodes = n->next;
+	return n;
+}
+
+static void freeNode(genNode * n)
+{
+	n->next = freeNodes;
+	freeNodes = n;
+}
+
+
 /* Generic Stack Functions */
 
 Stack newStack(size_t elementSize) 
@@ -26,13 +44,20 @@ Stack newStack(size_t elementSize)
 	Stack s = new(sizeof(struct Stack_tag));
 	s->top = NULL;
 	s->elementSize = elementSize;
+	s->free = NULL;
 	return s;
 }
 
+//reuses a popped node of the same stack, together with its data
 void push(Stack stack)
 {
-	genNode *n = (genNode *) new(sizeof(genNode));
-	n->data = new(stack->elementSize);
+	genNode *n = stack->free;
+	if(n!=NULL)
+		stack->free = n->next;
+	else {
+		n = (genNode *) new(sizeof(genNode));
+		n->data = new(stack->elementSize);
+	}
 	n->next = stack->top;
 	stack->top = n;
 }
@@ -42,8 +67,8 @@ void pop(Stack stack)
 	if(stack->top==NULL) internal("attempt to pop from empty stack");
 	genNode *temp = stack->top;
 	stack->top = stack->top->next;
-	delete(temp->data);
-	delete(temp);
+	temp->next = stack->free;
+	stack->free = temp;
 }
 
 void *top(Stack stack)	
@@ -67,7 +92,7 @@ Queue newQueue(size_t elementSize)
 //allocates new data Node in start but does not insert data in the start
 void addFirst(Queue queue)
 {
-	genNode *n = (genNode *) new(sizeof(genNode));
+	genNode *n = newNode();
 	n->data = new(queue->elementSize);
 	if(queue->first==NULL){
 		n->next = NULL;
@@ -80,7 +105,7 @@ void addFirst(Queue queue)
 //does not allocate new data Node, but inserts data pointer in the start
 void addFirstData(Queue q, void * data)
 {
-	genNode *n = (genNode *) new(sizeof(genNode));
+	genNode *n = newNode();
 	n->data = data;
 	if(q->first==NULL){
 		n->next = NULL;
@@ -93,7 +118,7 @@ void addFirstData(Queue q, void * data)
 //allocates new data Node in end but does not insert data at the end
 void addLast(Queue queue)
 {
-	genNode *n = (genNode *) new(sizeof(genNode));
+	genNode *n = newNode();
 	n->data = new(queue->elementSize);
 	n->next = NULL;
 	if(queue->last==NULL){
@@ -106,7 +131,7 @@ void addLast(Queue queue)
 //does not allocate new data Node, but inserts data pointer at the end
 void addLastData(Queue q,void * data)
 {
-	genNode *n = (genNode *) new(sizeof(genNode));
+	genNode *n = newNode();
 	n->data = data;
 	n->next = NULL;
 	if(q->last==NULL){
@@ -135,7 +160,7 @@ void *removeFirst(Queue q)
 	genNode * temp = q->first;
 	q->first = q->first->next;
 	if(q->first==NULL) q->last=NULL; //queue empty
-	delete(temp);
+	freeNode(temp);
 	return data;
 }
 
@@ -16,6 +16,7 @@ typedef struct genNode_tag {
 struct Stack_tag {
 	genNode	*	top;
 	size_t		elementSize;
+	genNode	*	free;		//popped nodes (with their data), reused by push
 };
 
 typedef struct Stack_tag *Stack;
@@ -24,6 +24,9 @@
 #include "datastructs.h"
 #include "symbol.h"
 #include "error.h"
+#include "output.h"
+#include "regalloc.h"
+#include "asm.h"
 
 
 /* ----------------------------------------------------------- 
@@ -31,13 +34,7 @@
    ----------------------------------------------------------- */
 
 
-#define STRING_LABEL_BUF_SIZE	9		/* bytes needed to buffer a string label in a char array. Limits string literals to 9999. */
-#define LABEL_BUF_SIZE			6		/* bytes needed to buffer a quad or a function label in a char array. Limits to 9999 quads & 999 functions */
-#define STR_BUF_SIZE			64		/* bytes allocated for the temporary buffer of str function */
-
-/* Number of string literals in a tony program supported: 10^(STRING_LABEL_SIZE-5) */
-
-/* For buf sizes, add one to increase number supported by a factor of 10 */
+#define STR_BUF_NUM				8		/* results of str() that can be in use at the same time */
 
 #define PRINTABLE_ASCII(CHAR) ((CHAR)>31 ? true : false)
 
@@ -58,6 +55,11 @@ static void		codeq			(Quad q);															//print in commented format the ori
 static void		load			(char * reg, Operand o);
 static void		loadAddr		(char * reg, Operand o);
 static void		store			(char * reg, Operand o);
+static char *	inRegister		(Operand o);
+static char *	immediate		(Operand o);
+static char *	direct			(Operand o);
+static bool		inMemory		(char * operand);
+static bool		intConstant		(Operand o, int * value);
 static void		getAR			(SymbolEntry * s);
 static void		updateAL		(SymbolEntry * s);
 
@@ -66,6 +68,10 @@ static char *	endof			(Operand o);
 static char *	label			(Operand o);
 
 static void		printConditional(char * instr, Quad q);
+static void		printAdditive	(char * instr, Quad q);
+static void		printArray		(Quad q);
+static void		printMultiplicative	(Quad q);
+static void		findTargets		();
 
 static void		insertExtern	(char * func);
 static void		printExtern		();
@@ -75,9 +81,12 @@ static void		printStrings	();
 static char *	fixString		(char * str);
 
 static void		createCallTable	();
+static void		registerCallTables	(Queue gcfunc);
 
 static char *	str             (const char *s, ...);
 static int		typeSize		(Operand o);
+static int		frameSize		(SymbolEntry * f);
+static char *	display			(int level);
 static int		refTypeSize		(Operand o);
 
 /* -------------------------------------------------------------
@@ -94,11 +103,24 @@ static int		stringsNum = 0;
 
 static Operand	currentUnit;		//the unit whose final code is generated, useful for jumps
 static int		currentNestingLevel;
+static int		displayLevels = 0;	//entries of the display (-fdisplay): the deepest nesting level of locals + 1
+static int		siLevel = -1;		//nesting level of the locals of the activation record si points to (getAR), -1 if unknown
+
+bool			displayMode = false;	//non-locals through a display (-fdisplay), not the access links
+bool			asmComments = true;	//print every quad as a comment before its final code (not in compact mode)
+
+/* For every quad: whether some jump targets it (its label is printed) and, for an O_ENDU,
+ * whether some O_RET of its unit jumps to the end of the unit */
+#define TARGET_LABEL	1
+#define TARGET_ENDOF	2
+static char *	targets = NULL;
+static int		targetsSize = 0;
 
 #ifndef GC_FREE
 static int		gcCallNum = 1;		//number of gc calls in a function
 static Queue	gcCallParam;
 static Queue	gcHungryVar;		//Queue only for this file
+static bool		gcLateRegister = false;	//gc hungry functions are registered by a procedure printed in skeletonEnd (streaming mode)
 #endif
 
 /* -------------------------------------------------------------
@@ -116,65 +138,51 @@ void initFinal()
 void printFinal() 
 {
 	int i;
+	findTargets();
 	for (i = 1; i < quadNext; i++)
 	{
 		Quad qd = q[i];
-		if (!ISACTIVE(qd.num)) 
-			continue; //quad has been removed by optimizer
+		if (!ISACTIVE(qd.num)) {
+			//quad has been removed by optimizer, jumps to it go on to the next one
+			if (targets[i] & TARGET_LABEL)
+				codel(label(oL(i)), NULL, NULL, NULL, true);
+			continue;
+		}
 		Operand x = qd.x;
 		Operand y = qd.y;
 		Operand z = qd.z;
-		codeq(qd);
-		codel(label(oL(i)), NULL, NULL, NULL, true);
+		if (asmComments)
+			codeq(qd);
+		if (targets[i] & TARGET_LABEL)
+			codel(label(oL(i)), NULL, NULL, NULL, true);
 		switch(qd.op) {
 			case O_ASSIGN:
-				if(typeSize(x) == 1) {
-					load("bl",x);
-					store("bl",z);
+				if (immediate(x) != NULL) {
+					char imm[16];	//store() may use all the str() buffers
+					snprintf(imm, sizeof(imm), "%s", immediate(x));
+					store(imm,z);
+				} else if(typeSize(x) == 1) {
+					load("al",x);
+					store("al",z);
 				} else if(typeSize(x) == 2) {
-					load("bx",x);
-					store("bx",z);
+					if (inRegister(z) != NULL)			load(inRegister(z),x);	//straight into the register
+					else if (inRegister(x) != NULL)	store(inRegister(x),z);
+					else								{load("ax",x);	store("ax",z);}
 				} else internal("final: printFinal(): unhandled type size case");
 				break;
 			case O_ARRAY:
-				load("ax",y);
-				code("mov","cx",str("%d",refTypeSize(x)));
-				code("imul","cx",NULL);
-				load("cx",x);	//ATTENTION: we modified this. In theory it is loadAddress("cx",x)
-				code("add","ax","cx");
-				store("ax",z);
+				printArray(qd);
 				break;
 			case O_ADD:
-				load("ax",x);
-				load("dx",y);
-				code("add","ax","dx");
-				store("ax",z);
+				printAdditive("add",qd);
 				break;
 			case O_SUB:
-				load("ax",x);
-				load("dx",y);
-				code("sub","ax","dx");
-				store("ax",z);
+				printAdditive("sub",qd);
 				break;
 			case O_MULT:
-				load("ax",x);
-				load("cx",y);
-				code("imul","cx",NULL);
-				store("ax",z);
-				break;
 			case O_DIV:
-				load("ax",x);
-				code("cwd",NULL,NULL);
-				load("cx",y);
-				code("idiv","cx",NULL);
-				store("ax",z);
-				break;
 			case O_MOD:
-				load("ax",x);
-				code("cwd",NULL,NULL);
-				load("cx",y);
-				code("idiv","cx",NULL);
-				store("dx",z);
+				printMultiplicative(qd);
 				break;
 			case O_EQ:
 				printConditional("je",qd);	
@@ -195,8 +203,12 @@ void printFinal()
 				printConditional("jge",qd);	
 				break;
 			case O_IFB:
-				load("al",x);
-				code("or","al","al");
+				if (inMemory(direct(x)))
+					code("cmp",direct(x),"0");
+				else {
+					load("al",x);
+					code("or","al","al");
+				}
 				code("jnz",label(z),NULL);
 				break;
 			case O_JUMP:
@@ -207,17 +219,31 @@ void printFinal()
 				code("push","bp",NULL);
 				code("mov","bp","sp");
 				SymbolEntry * se = getSymbol(x);
-				int localSize = - se->u.eFunction.negOffset;
+				int localSize = frameSize(se);
 				currentNestingLevel = se->nestingLevel + 1;
-				code("sub","sp",str("%d",localSize));
+				if (localSize > 0) code("sub","sp",str("%d",localSize));	//nothing to reserve when every temporary is in a register
+				if (displayMode) {	//the entry of the level is kept below the locals and points to this record
+					code("mov","ax",display(currentNestingLevel));
+					code("mov",str("word ptr [bp-%d]",localSize),"ax");
+					code("mov",display(currentNestingLevel),"bp");
+				}
 				//it is always the first quad to be printed in a block, so we can now save the name of the block
 				currentUnit = x;
 				break;
 			case O_ENDU:
-				codel(endof(x),"mov","sp","bp",true);
+				if (displayMode) {
+					char * restore = str("word ptr [bp-%d]",frameSize(getSymbol(x)));
+					if (targets[i] & TARGET_ENDOF)	codel(endof(x),"mov","ax",restore,true);
+					else							code("mov","ax",restore);
+					code("mov",display(getSymbol(x)->nestingLevel + 1),"ax");
+					code("mov","sp","bp");
+				}
+				else if (targets[i] & TARGET_ENDOF)	codel(endof(x),"mov","sp","bp",true);
+				else								code("mov","sp","bp");
 				code("pop","bp",NULL);
 				code("ret",NULL,NULL);
 				codel(name(x),"endp",NULL,NULL,false);
+				asmFlush();
 				#ifndef GC_FREE
 				createCallTable();
 				#endif
@@ -234,7 +260,7 @@ void printFinal()
 				int paramSize = s->u.eFunction.posOffset;
 				#ifndef GC_FREE
 				if(s->u.eFunction.gcHungry){
-					fprintf(fout,"@%s_call_%d:\n",name(currentUnit)+1,gcCallNum++);
+					codel(str("@%s_call_%d",name(currentUnit)+1,gcCallNum++),NULL,NULL,NULL,true);
 					addLastData(gcCallParam,&paramSize);
 				}
 				#endif
@@ -250,6 +276,8 @@ void printFinal()
 						code("sub","sp","1");
 						code("mov","si","sp");
 						code("mov","byte ptr [si]","al");
+					} else if (typeSize(x) == 2 && direct(x) != NULL && immediate(x) == NULL) {
+						code("push",direct(x),NULL);	//no push of an immediate on the 8086
 					} else if (typeSize(x) == 2) {
 						load("ax",x);
 						code("push","ax",NULL);
@@ -272,14 +300,14 @@ void skeletonBegin(Operand prog, Queue gcfunc, Queue gcvar)
 	#ifdef DEBUG
 	printf("skeletonBegin starts\n");
 	#endif
-	fprintf(fout,
+	outFmt(asmOut,
 			"xseg\tsegment\tpublic 'code'\n"
 			"\tassume\tds:xseg, ss:xseg\n"	/* we deleted "cs:xseg, " here to avoid asm a4004 warning */
 			"\torg\t100h\n"
 			"main\tproc\tnear\n");
 	#ifndef GC_FREE
 	/* Initialize memory */
-	fprintf(fout,";; initialize memory: 2/3 heap and 1/3 stack\n");
+	outFmt(asmOut,";; initialize memory: 2/3 heap and 1/3 stack\n");
 	code("mov","cx","OFFSET DGROUP:_start_of_space");
 	code("mov","word ptr _space_from","cx");
 	code("mov","word ptr _next","cx");
@@ -295,15 +323,19 @@ void skeletonBegin(Operand prog, Queue gcfunc, Queue gcvar)
 	code("add","cx","ax");
 	code("mov","word ptr _limit_to","cx");
 	/* Register allocating functions */
-	fprintf(fout,";;; register gc hungry functions\n");
-	while(!isEmpty(gcfunc)) {
-		Operand func = removeFirst(gcfunc);
-		code("mov","ax",str("OFFSET %s_call_table",name(func)));
-		code("call","near ptr _register_call_table",NULL);
+	asmFlush();
+	outFmt(asmOut,";;; register gc hungry functions\n");
+	if(gcfunc == NULL) {
+		//not known yet (streaming mode), they will be registered by _init_call_tables printed in skeletonEnd
+		gcLateRegister = true;
+		code("call","near ptr _init_call_tables",NULL);
 	}
+	else
+		registerCallTables(gcfunc);
 	#endif
 	/* Call main, print _ret_of_main label and exit */
-	fprintf(fout,
+	asmFlush();
+	outFmt(asmOut,
 			";;; calling main\n"
 			"\tcall\tnear ptr %s\n"
 			#ifndef GC_FREE
@@ -322,13 +354,22 @@ void skeletonBegin(Operand prog, Queue gcfunc, Queue gcvar)
 	#endif
 }
 
-void skeletonEnd() 
+void skeletonEnd(Queue gcfunc) 
 {
+	#ifndef GC_FREE
+	if(gcLateRegister) {
+		codel("_init_call_tables","proc","near",NULL,false);
+		registerCallTables(gcfunc);
+		code("ret",NULL,NULL);
+		codel("_init_call_tables","endp",NULL,NULL,false);
+		asmFlush();
+	}
+	#endif
 	printStrings();
 	printExtern();
 	#ifndef GC_FREE
-	fprintf(fout,"\textrn\t_register_call_table : proc\n");
-	fprintf(fout,"\tpublic\t_next\n"
+	outFmt(asmOut,"\textrn\t_register_call_table : proc\n");
+	outFmt(asmOut,"\tpublic\t_next\n"
 			"\tpublic\t_space_from\n"
 			"\tpublic\t_limit_from\n"
 			"\tpublic\t_space_to\n"
@@ -341,36 +382,37 @@ void skeletonEnd()
 			"_limit_to\tdw\t?\n"
 			);
 	#endif
-	fprintf(fout,"\txseg\tends\n");
+	if (displayMode && displayLevels > 0)
+		outFmt(asmOut,"_display\tdw\t%d dup(?)\n",displayLevels);
+	outFmt(asmOut,"\txseg\tends\n");
 	#ifndef GC_FREE
-	fprintf(fout,"_DATA_END\tsegment\tbyte public 'stack'\n"
+	outFmt(asmOut,"_DATA_END\tsegment\tbyte public 'stack'\n"
 			"_start_of_space\tlabel\tbyte\n"
 			"_DATA_END\tends\n"
 			"DGROUP\tgroup\txseg, _DATA_END\n");
 	#endif
-	fprintf(fout,"\tend\tmain\n");
+	outFmt(asmOut,"\tend\tmain\n");
 }
 
 /* Printing functions for assembly commands */
 /* -------------------------------------------------------- */
+/* They go to the instructions of the unit (asm.c), printed by asmFlush() at its end.
+ * What si points to is forgotten when it is written, at a call and at a label (it may be reached
+ * by a jump) */
 
-
-void code(char * command, char * a1, char * a2)				
-{	
-	if (command != NULL)	fprintf(fout, "\t%s", command);
-	if (a1 != NULL)			fprintf(fout, "\t%s", a1);
-	if (a2 != NULL)			fprintf(fout, ", %s", a2); 
-	fprintf(fout, "\n");
+void code(char * command, char * a1, char * a2)
+{
+	if (command != NULL && (!strcmp(command,"call") || (a1 != NULL && !strcmp(a1,"si")))) siLevel = -1;
+	asmCode(NULL, false, command, a1, a2);
 }
 
 void codel(char * label, char * command, char * a1, char * a2, bool colon)
-{ 
-	if (label != NULL)		fprintf(fout, "%s", label);
-	if (colon)				fprintf(fout, ":");
-	code(command, a1, a2);
+{
+	siLevel = -1;
+	asmCode(label, colon, command, a1, a2);
 }
 
-void codeq(Quad q)	{ fprintf(fout, ";;; %d: %s, %s, %s, %s\n", q.num, otostr(q.op), q.x->name, q.y->name, q.z->name); }
+void codeq(Quad q)	{ asmComment(str(";;; %d: %s, %s, %s, %s", quadBase + q.num, otostr(q.op), operandName(q.x), operandName(q.y), operandName(q.z))); }
 
 
 /* -------------------------------------------------------------
@@ -380,6 +422,10 @@ void codeq(Quad q)	{ fprintf(fout, ";;; %d: %s, %s, %s, %s\n", q.num, otostr(q.o
 
 void load(char * r, Operand o){
 
+	if (inRegister(o) != NULL) {
+		if (strcmp(r, inRegister(o)))	code("mov",r,inRegister(o));
+		return;
+	}
 	switch(o->type){
 		
 		char * size;
@@ -391,10 +437,9 @@ void load(char * r, Operand o){
 
 				case ENTRY_CONSTANT:
 					if(equalType(s->u.eConstant.type,typeInteger))		code("mov",r,str("%d",s->u.eConstant.value.vInteger));
-					else if(strcmp(o->name,"true")==0)					code("mov",r,"1");
-					else if(strcmp(o->name,"false")==0)					code("mov",r,"0");
+					else if(equalType(s->u.eConstant.type,typeBoolean))	code("mov",r,s->u.eConstant.value.vBoolean ? "1" : "0");
 					else if(equalType(s->u.eConstant.type,typeChar))	code("mov",r,str("%d",s->u.eConstant.value.vChar));	
-					else if(strcmp(o->name,"nil")==0)					code("mov",r,"0");
+					else if(s->u.eConstant.type->kind==TYPE_LIST)		code("mov",r,"0");	//nil
 					else if(equalType(s->u.eConstant.type,
 									typeIArray(typeChar)))				loadAddr(r,o); //strings
 					else												internal("final: load: unhandled case in constants");
@@ -451,6 +496,7 @@ void load(char * r, Operand o){
 			break;
 		
 		case OPERAND_DEREFERENCE:
+			if (direct(o) != NULL)	{code("mov",r,direct(o)); break;}	//[bx], [si], [di]
 			if(typeSize(o)==1) size="byte"; else size="word";
 			load("di",oS(getSymbol(o)));
 			code("mov",r,str("%s ptr [di]",size));
@@ -538,7 +584,7 @@ void loadAddr(char * r,Operand o)
 			internal("final: load: unhandled operand type (type=%d)",o->type);
 	}
 	#ifdef DEBUG
-	printf("%s out of loadAddr\n",getSymbol(o)->id);
+	printf("%s out of loadAddr\n",entryName(getSymbol(o)));
 	#endif
 }
 
@@ -548,6 +594,10 @@ void store(char *r, Operand o)
 	int offset;
 	SymbolEntry *s = NULL;
 
+	if (inRegister(o) != NULL) {
+		if (strcmp(r, inRegister(o)))	code("mov",inRegister(o),r);
+		return;
+	}
 	switch(o->type){
 		case OPERAND_SYMBOL:
 			s = o->u.symbol;
@@ -611,6 +661,7 @@ void store(char *r, Operand o)
 			break;
 
 		case OPERAND_DEREFERENCE:
+			if (direct(o) != NULL)	{code("mov",direct(o),r); break;}
 			if (typeSize(o) == 1) size="byte"; else size="word";
 			load("di",oS(getSymbol(o)));
 			code("mov",str("%s ptr [di]",size),r);
@@ -621,13 +672,77 @@ void store(char *r, Operand o)
 	}
 }
 
+//the register of a temporary that regalloc.c gave one, NULL for the rest
+char * inRegister(Operand o)
+{
+	SymbolEntry * s = getSymbol(o);
+	if (o->type != OPERAND_SYMBOL || s->entryType != ENTRY_TEMPORARY || s->u.eTemporary.reg < 0) return NULL;
+	return (char *) registerName[s->u.eTemporary.reg];
+}
+
+//a constant as an immediate operand, NULL for the rest (a string is an address: lea)
+char * immediate(Operand o)
+{
+	SymbolEntry * s = getSymbol(o);
+	if (o->type != OPERAND_SYMBOL || s->entryType != ENTRY_CONSTANT) return NULL;
+	if(equalType(s->u.eConstant.type,typeInteger))		return str("%d",s->u.eConstant.value.vInteger);
+	if(equalType(s->u.eConstant.type,typeBoolean))		return s->u.eConstant.value.vBoolean ? "1" : "0";
+	if(equalType(s->u.eConstant.type,typeChar))			return str("%d",s->u.eConstant.value.vChar);
+	if(s->u.eConstant.type->kind==TYPE_LIST)			return "0";	//nil
+	return NULL;
+}
+
+bool intConstant(Operand o, int * value)
+{
+	SymbolEntry * s = getSymbol(o);
+	if (o->type != OPERAND_SYMBOL || s->entryType != ENTRY_CONSTANT || !equalType(s->u.eConstant.type,typeInteger)) return false;
+	*value = s->u.eConstant.value.vInteger;
+	return true;
+}
+
+/* o as the operand of an instruction, without loading it first: a constant, a temporary in a
+ * register, a local in the frame or [t] with t in a base register. NULL for what is reached
+ * through si or di (non-locals, parameters by reference, $$) */
+char * direct(Operand o)
+{
+	SymbolEntry * s = getSymbol(o);
+	char * r, * size;
+	if ((r = immediate(o)) != NULL || (r = inRegister(o)) != NULL) return r;
+	if (s == NULL || (o->type != OPERAND_SYMBOL && o->type != OPERAND_DEREFERENCE)) return NULL;
+	if(typeSize(o)==1) size="byte"; else size="word";
+	if (o->type == OPERAND_DEREFERENCE) {
+		r = inRegister(oS(s));
+		if (r == NULL || !strcmp(r,"cx") || !strcmp(r,"dx")) return NULL;
+		return str("%s ptr [%s]",size,r);
+	}
+	if (s->nestingLevel != currentNestingLevel) return NULL;
+	switch (s->entryType) {
+		case ENTRY_VARIABLE:	return str("%s ptr [bp%d]",size,s->u.eVariable.offset);
+		case ENTRY_TEMPORARY:	return str("%s ptr [bp%d]",size,s->u.eTemporary.offset);
+		case ENTRY_PARAMETER:	return s->u.eParameter.mode == PASS_BY_VALUE ? str("%s ptr [bp+%d]",size,s->u.eParameter.offset) : NULL;
+		default:				return NULL;
+	}
+}
+
+//an instruction has at most one memory operand
+bool inMemory(char * operand) { return operand != NULL && strchr(operand,'[') != NULL; }
+
+//si := the activation record of the locals of s, from the one si already points to if it is not deeper
 void getAR(SymbolEntry * s)
 {
-	code("mov","si","word ptr [bp+4]");
-	int i;
-	int links = currentNestingLevel - s->nestingLevel - 1;
-	for(i=0;i<links;i++)
+	int level = siLevel, target = s->nestingLevel;
+	if (displayMode) {
+		if (level != target) code("mov","si",display(target));
+		siLevel = target;
+		return;
+	}
+	if (level < target) {
+		code("mov","si","word ptr [bp+4]");
+		level = currentNestingLevel - 1;
+	}
+	for (; level > target; level--)
 		code("mov","si","word ptr [si+4]");
+	siLevel = target;
 }
 
 
@@ -643,68 +758,148 @@ void updateAL(SymbolEntry * s)
 		code("push","bp",NULL);
 	else if (np == nx)
 		code("push","word ptr [bp+4]",NULL);
+	else if (displayMode)
+		code("push",display(nx),NULL);	//the record of the parent of the callee, the one of its level
 	else
 		{getAR(s);	code("push","word ptr [si+4]",NULL);}
 }
 
 
-//support up to 10^(LABEL_BUF_SIZE-2) quads
+//label(), name() and endof() return a str() buffer, valid until STR_BUF_NUM more calls
 char * label(Operand o)
 {
 	if(o->type!=OPERAND_QLABEL) internal("final: label() should be called with an OPERAND_QLABEL Operand");
-	char * buf = (char *) new(LABEL_BUF_SIZE*sizeof(char));
-	sprintf(buf,"@%d",o->u.quadLabel);
-	return buf;
+	return str("@%d",quadBase + o->u.quadLabel);
 }
 
-//supports up to 10^(LABEL_BUF_SIZE-3) functions
 char * name(Operand o)
 {
 	if(o->type!=OPERAND_UNIT) internal("final: name() must be called with an OPERAND_UNIT Operand");
 	const char * p = o->name; 
-	char * buf = (char *) new((strlen(p)+LABEL_BUF_SIZE)*sizeof(char));
+	char * buf;
 	SymbolEntry * s = o->u.symbol;
 	int num	= s->u.eFunction.serialNum;
-	if(!isLibFunc(s))	sprintf(buf,"_%s_%d",p,num);	//ordinary function	
-	else				sprintf(buf,"_%s",p);			//run-time Library Function
+	if(!isLibFunc(s))	buf = str("_%s_%d",p,num);	//ordinary function	
+	else				buf = str("_%s",p);			//run-time Library Function
 	#ifdef DEBUG
 	printf("exiting name() with buf: %s\n",buf);
 	#endif
 	return buf;
 }
 
-//supports up to 10^(LABEL_BUF_SIZE-3) functions
 char * endof(Operand o)
 {
 	if(o->type!=OPERAND_UNIT) internal("final: endof() must be called with an OPERAND_UNIT Operand");
 	const char * p = o->name;
-	char * buf = (char *) new((strlen(p)+LABEL_BUF_SIZE)*sizeof(char));
 	SymbolEntry * s = o->u.symbol;
 	int num	= s->u.eFunction.serialNum;
-	if(!isLibFunc(s))	sprintf(buf,"@%s_%d",p,num);	//ordinary function	
-	else				internal("final: endof called in a runtime library function");
-	return buf;
+	if(isLibFunc(s))	internal("final: endof called in a runtime library function");
+	return str("@%s_%d",p,num);	//ordinary function	
 }
 
 
+/* Labels are printed only for the quads that are targets of jumps (O_JUMP, O_IFB and the
+ * relational operators) and end of unit labels only for units that contain an O_RET */
+void findTargets()
+{
+	int i;
+	bool ret = false;
+	if (targetsSize < (int) quadNext + 1) {
+		delete(targets);
+		targetsSize = 2 * quadNext + 1;
+		targets = (char *) new(targetsSize);
+	}
+	for (i = 0; i <= quadNext; i++) targets[i] = 0;
+	for (i = 1; i < quadNext; i++) {
+		if (!ISACTIVE(q[i].num)) continue;
+		switch (q[i].op) {
+			case O_JUMP: case O_IFB:
+			case O_EQ: case O_NE: case O_LT: case O_GT: case O_LE: case O_GE:
+				if (q[i].z->type == OPERAND_QLABEL) targets[q[i].z->u.quadLabel] |= TARGET_LABEL;
+				break;
+			case O_UNIT:	ret = false;						break;
+			case O_RET:		ret = true;							break;
+			case O_ENDU:	if (ret) targets[i] |= TARGET_ENDOF;	break;
+			default:		break;
+		}
+	}
+}
+
 void printConditional(char * instr,Quad q)
 {
-	if (typeSize(q.x) == 1){
-		load("al",q.x);
-		load("dl",q.y);
-		code("cmp","al","dl");
-		if(q.z->type!=OPERAND_QLABEL) internal("final: printConditional(): Operand z must be of type OPERAND_QLABEL");
-		code(instr,label(q.z),NULL);
+	char * acc, * aux;
+	if (typeSize(q.x) == 1)			{acc = "al";	aux = "dl";}
+	else if (typeSize(q.x) == 2)	{acc = "ax";	aux = "dx";}
+	else							internal("final: printConditional(): unhandled case for type size ");
+	if(q.z->type!=OPERAND_QLABEL) internal("final: printConditional(): Operand z must be of type OPERAND_QLABEL");
+	if (direct(q.x) != NULL && immediate(q.x) == NULL && direct(q.y) != NULL && !(inMemory(direct(q.x)) && inMemory(direct(q.y))))
+		code("cmp",direct(q.x),direct(q.y));	//cmp word ptr [bp-2], 5
+	else {
+		load(acc,q.x);
+		if (direct(q.y) != NULL)	code("cmp",acc,direct(q.y));
+		else						{load(aux,q.y);	code("cmp",acc,aux);}
+	}
+	code(instr,label(q.z),NULL);
+}
+
+/* z := x + y, z := x - y. In place when z is x (add word ptr [bp-2], 1), in the register of z
+ * when it has one, through ax otherwise */
+void printAdditive(char * instr, Quad q)
+{
+	Operand x = q.x, y = q.y;
+	char * r;
+	if (!strcmp(instr,"add") && immediate(x) != NULL)	{x = q.y;	y = q.x;}	//the constant second
+	if (direct(y) != NULL && q.z == x && (r = direct(q.z)) != NULL && !(inMemory(r) && inMemory(direct(y))))
+		code(instr,direct(q.z),direct(y));
+	else if (direct(y) != NULL && (r = inRegister(q.z)) != NULL && strstr(direct(y),r) == NULL) {
+		load(r,x);
+		code(instr,r,direct(y));
+	}
+	else {
+		load("ax",x);
+		if (direct(y) != NULL)	code(instr,"ax",direct(y));
+		else					{load("dx",y);	code(instr,"ax","dx");}
+		store("ax",q.z);
+	}
+}
+
+/* z := x * y, x / y, x mod y: the operand of imul, idiv from memory or a register, a power of
+ * two as shifts */
+void printMultiplicative(Quad q)
+{
+	Operand x = q.x, y = q.y;
+	int c, k;
+	if (q.op == O_MULT && intConstant(x,&c) && !intConstant(y,&k))	{x = q.y;	y = q.x;}
+	load("ax",x);
+	if (q.op == O_MULT && intConstant(y,&c) && c > 0 && (c & (c - 1)) == 0 && c <= 16)
+		for (k = 1; k < c; k *= 2) code("shl","ax","1");
+	else {
+		if (q.op != O_MULT)	code("cwd",NULL,NULL);
+		if (inMemory(direct(y)) || inRegister(y) != NULL)	code(q.op == O_MULT ? "imul" : "idiv",direct(y),NULL);
+		else									{load("cx",y);	code(q.op == O_MULT ? "imul" : "idiv","cx",NULL);}
+	}
+	store(q.op == O_MOD ? "dx" : "ax",q.z);
+}
+
+/* z := address of x[y]: the size of the elements (1 or 2) as nothing or a shift, a constant
+ * index folded into a displacement */
+void printArray(Quad q)
+{
+	int size = refTypeSize(q.x), index;
+	char * acc = (inRegister(q.z) != NULL) ? inRegister(q.z) : "ax";
+	if (intConstant(q.y,&index)) {
+		load(acc,q.x);	//ATTENTION: we modified this. In theory it is loadAddress(acc,x)
+		if (index * size != 0) code("add",acc,str("%d",index * size));
 	}
-	else if (typeSize(q.x) == 2) {
-		load("ax",q.x);
-		load("dx",q.y);
-		code("cmp","ax","dx");
-		if(q.z->type!=OPERAND_QLABEL) internal("final: printConditional(): Operand z must be of type OPERAND_QLABEL");
-		code(instr,label(q.z),NULL);
+	else {
+		if (size > 2 || direct(q.x) == NULL || strstr(direct(q.x),acc) != NULL) acc = "ax";
+		load(acc,q.y);
+		if (size == 2)		code("shl",acc,"1");
+		else if (size > 2)	{code("mov","cx",str("%d",size));	code("imul","cx",NULL);}
+		if (direct(q.x) != NULL)	code("add",acc,direct(q.x));
+		else						{load("cx",q.x);	code("add",acc,"cx");}
 	}
-	else 
-		internal("final: printConditional(): unhandled case for type size ");
+	store(acc,q.z);
 }
 
 
@@ -716,19 +911,19 @@ void insertExtern(char * func)
 	int i;
 	for(i=0;i<extrnNum;i++)
 		if(strcmp(func,extrn[i])==0) return; //function already expressed wish to be declared
-	extrn[extrnNum++] = func;
+	extrn[extrnNum++] = arenaStrdup(globalArena,func);	//func is a str() buffer
 }
 
 void printExtern() 
 { 
 	int i;   
-	fprintf(fout,";;; extern library functions\n"); 
+	outFmt(asmOut,";;; extern library functions\n"); 
 	for(i=0;i<extrnNum;i++){	
-		fprintf(fout,"\textrn\t%s : proc\n",extrn[i]); 
+		outFmt(asmOut,"\textrn\t%s : proc\n",extrn[i]); 
 		#ifndef GC_FREE
 		/* FIXME: avoid hardcoded way to add _cons_call_tables */
-		if(strcmp(extrn[i],"_consv")==0) fprintf(fout,"\textrn\t_consv_call_table : word\n");
-		if(strcmp(extrn[i],"_consp")==0) fprintf(fout,"\textrn\t_consp_call_table : word\n");
+		if(strcmp(extrn[i],"_consv")==0) outFmt(asmOut,"\textrn\t_consv_call_table : word\n");
+		if(strcmp(extrn[i],"_consp")==0) outFmt(asmOut,"\textrn\t_consp_call_table : word\n");
 		#endif
 	}
 }
@@ -742,7 +937,7 @@ char * fixString(char * str)
 {
 	int i,j,shift;
 	int length = strlen(str);
-	char * buf = (char *) new(length*sizeof(char));
+	char * buf = (char *) new((length+1)*sizeof(char));
 	i = j = 0; 
 	while(i<length){
 		buf[j++]=fixChar(str+i,&shift);
@@ -752,17 +947,15 @@ char * fixString(char * str)
 	return buf;
 }
 
-//support up to STRINGS_MAX strings (limmited to 10^(STRING_LABLE_BUF_SIZE-4)
 char * insertString(SymbolEntry * s)
 {
 #ifdef DEBUG
 	printf("entering insertString()\n");
 #endif
 	if(s->entryType!=ENTRY_CONSTANT || !equalType(s->u.eConstant.type,typeIArray(typeChar))) internal("final: insertString() not called with string");
-	char * str = fixString(strdup(s->u.eConstant.value.vString));
-	addLastData(strings,str);
-	char * buf = (char *) new(STRING_LABEL_BUF_SIZE*sizeof(char));
-	sprintf(buf,"@str%d",stringsNum);
+	char * fixed = fixString((char *) s->u.eConstant.value.vString);
+	addLastData(strings,fixed);
+	char * buf = str("@str%d",stringsNum);
 	stringsNum++;
 #ifdef DEBUG
 	printf("exiting insertString() with stringNum %d and string: %s\n",stringsNum,buf);
@@ -777,9 +970,9 @@ void printStrings()
 	#endif
 
 	int i,j;
-	fprintf(fout,";;; string literals\n"); 
+	outFmt(asmOut,";;; string literals\n"); 
 	for(i=0;i<stringsNum;i++){
-		fprintf(fout,"@str%d",i);
+		outFmt(asmOut,"@str%d",i);
 		char * buf = removeFirst(strings);
 		if(buf==NULL) fatal("printStrings(): attempted to print a null string");
 		int buflen = strlen(buf);
@@ -787,22 +980,33 @@ void printStrings()
 		/* Note: starting from j=1 and finishing at strlen-1 in order to ommit start and end quotes "str" */
 		for(j=1;j<buflen-1;j++){
 			if(PRINTABLE_ASCII(buf[j])){
-				if(!printableSeq) fprintf(fout,"\tdb\t'"); //this is the first printable char of a printalbe sequence to be printed in new db line
+				if(!printableSeq) outFmt(asmOut,"\tdb\t'"); //this is the first printable char of a printalbe sequence to be printed in new db line
 				printableSeq = true;
-				fprintf(fout,"%c",buf[j]);
+				outChar(asmOut,buf[j]);
 			}
 			else{ 
-				if(printableSeq) fprintf(fout,"'\n"); //close printable sequence
-				fprintf(fout,"\tdb\t%d\n",buf[j]);
+				if(printableSeq) outFmt(asmOut,"'\n"); //close printable sequence
+				outFmt(asmOut,"\tdb\t%d\n",buf[j]);
 				printableSeq = false;
 			}
 		}
-		if(printableSeq) fprintf(fout,"'\n"); //close printable sequence
-		fprintf(fout,"\tdb\t0\n");
+		if(printableSeq) outFmt(asmOut,"'\n"); //close printable sequence
+		outFmt(asmOut,"\tdb\t0\n");
 	}
 }
 
 #ifndef GC_FREE
+/* Function to register the call table of each gc hungry function */
+/* -------------------------------------------------------- */
+void registerCallTables(Queue gcfunc)
+{
+	while(!isEmpty(gcfunc)) {
+		Operand func = removeFirst(gcfunc);
+		code("mov","ax",str("OFFSET %s_call_table",name(func)));
+		code("call","near ptr _register_call_table",NULL);
+	}
+}
+
 /* Function to create call table for each gc hungry function */
 /* -------------------------------------------------------- */
 void createCallTable()
@@ -813,24 +1017,24 @@ void createCallTable()
 	printf("createCallTable for %s\n",currentUnit->name);
 	#endif
 	int i;
-	fprintf(fout,"%s_call_table:\n",name(currentUnit));
+	outFmt(asmOut,"%s_call_table:\n",name(currentUnit));
 	for(i=1;i<gcCallNum;i++){
 		int funcNum		= s->u.eFunction.serialNum;
 		char const * funcName = s->id;
-		fprintf(fout,"@call_%d_%d\tdw\t@%s_%d_call_%d\n",funcNum,i,funcName,funcNum,i);	//1st word
-		if(i!=gcCallNum-1)	fprintf(fout,"\tdw\t@call_%d_%d\n",funcNum,i+1);			//2nd word, next record exists
-		else				fprintf(fout,"\tdw\t0\n");									//2nd word, no next record
+		outFmt(asmOut,"@call_%d_%d\tdw\t@%s_%d_call_%d\n",funcNum,i,funcName,funcNum,i);	//1st word
+		if(i!=gcCallNum-1)	outFmt(asmOut,"\tdw\t@call_%d_%d\n",funcNum,i+1);			//2nd word, next record exists
+		else				outFmt(asmOut,"\tdw\t0\n");									//2nd word, no next record
 		int * paramSize = removeFirst(gcCallParam);
-		int localSize = - s->u.eFunction.negOffset;
-		fprintf(fout,"\tdw\t%d+%d+%d+%d\n",*paramSize+4,0,localSize,4);
+		int localSize = frameSize(s);
+		outFmt(asmOut,"\tdw\t%d+%d+%d+%d\n",*paramSize+4,0,localSize,4);
 		//list of next words, pointers to the heap
 		SymbolEntry * vars = getFirst(gcHungryVar);
 		while(vars!=NULL){
 			if(vars->entryType!=ENTRY_FUNCTION && vars->entryType!=ENTRY_CONSTANT && equalType(getType(vars),typeList(typeAny)))
-				fprintf(fout,"\tdw\t%d\t;%s\n",getOffset(vars),vars->id);
+				outFmt(asmOut,"\tdw\t%d\t;%s\n",getOffset(vars),entryName(vars));
 			vars = vars->nextInScope;
 		}
-		fprintf(fout,"\tdw\t0\n");
+		outFmt(asmOut,"\tdw\t0\n");
 	}
 	//reinitialize for new unit and throw away this unit's gc hungry variables
 	if(!isEmpty(gcCallParam)) internal("final: createCallTable(): gcCallParam Queue is not empty as it should");
@@ -843,16 +1047,23 @@ void createCallTable()
 /* Minor Helper Functions */
 /* -------------------------------------------------------- */
 
+/* Formats into one of STR_BUF_NUM buffers that are reused in turn, so the result is valid
+ * only until STR_BUF_NUM more calls (enough for the arguments of a code() call) */
 char * str(const char *s, ...)
 {
+	static OutBuf buf[STR_BUF_NUM];
+	static int next = 0;
+	OutBuf b;
 	va_list ap;
-	int len;
-	static char tmp_string[STR_BUF_SIZE];
+	if(buf[next]==NULL) buf[next] = newOutBuf(64);
+	b = buf[next];
+	next = (next + 1) % STR_BUF_NUM;
+	b->len = 0;
 	va_start(ap,s);
-	len = vsprintf(tmp_string,s,ap);
+	outVFmt(b,s,ap);
 	va_end(ap);
-	tmp_string[len] = '\0';
-	return strdup(tmp_string);
+	outChar(b,'\0');
+	return b->data;
 }
 
 int typeSize(Operand o)
@@ -874,6 +1085,19 @@ int typeSize(Operand o)
 	else if (o->type==OPERAND_UNIT)		return sizeOfType(type);
 }
 
+//bytes below bp: the locals and, with a display, the entry of the level it replaced
+int frameSize(SymbolEntry * f)
+{
+	return - f->u.eFunction.negOffset + (displayMode ? 2 : 0);
+}
+
+//the entry of the display for the activation records of the locals of level
+char * display(int level)
+{
+	if (level >= displayLevels) displayLevels = level + 1;
+	return str("word ptr _display+%d",2 * level);
+}
+
 //return the size of the element of an array (array is given as an Operand)
 int refTypeSize(Operand o)
 {
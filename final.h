@@ -19,8 +19,11 @@
 #define __FINAL_H__
 
 void	initFinal		();
-void	skeletonBegin	(Operand prog, Queue gcfunc, Queue gcvar);
-void	skeletonEnd		();
+void	skeletonBegin	(Operand prog, Queue gcfunc, Queue gcvar);	/* gcfunc may be NULL if not known yet (streaming mode) */
+void	skeletonEnd		(Queue gcfunc);	/* gcfunc is used only if skeletonBegin was called without it */
 void	printFinal		();
 
+extern bool asmComments;	/* false in compact mode (-c): quads are not printed as comments in the .asm file */
+extern bool displayMode;	/* -fdisplay: non-locals through a display of activation records, not the access links */
+
 #endif
@@ -24,6 +24,7 @@
    --------------------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "general.h"
 #include "error.h"
@@ -49,6 +50,138 @@ void delete (void * p)
 }
 
 
+/* ---------------------------------------------------------------------
+   ------------------- Υλοποίηση των arenas (our addition) -------------
+   --------------------------------------------------------------------- */
+
+#define ARENA_BLOCK_SIZE 65536        /* Μέγεθος block                   */
+#define ARENA_ALIGN      16           /* Στοίχιση των αντικειμένων        */
+#define ARENA_ROUND(n)   (((n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+typedef struct ArenaBlock_tag {
+   struct ArenaBlock_tag * next;
+   size_t                  size;      /* Χρήσιμα bytes του block          */
+   size_t                  used;      /* Bytes σε χρήση                   */
+   char                  * data;      /* Στοιχισμένη αρχή των δεδομένων   */
+} ArenaBlock;
+
+/* Blocks up to current are in use, the ones after it are free and get reused */
+struct Arena_tag {
+   const char * name;
+   ArenaBlock * first;
+   ArenaBlock * current;
+#ifdef DEBUG
+   unsigned long allocs;              /* Πλήθος δεσμεύσεων                */
+   unsigned long bytes;               /* Bytes που δεσμεύτηκαν            */
+   unsigned long blocks;              /* Blocks που πάρθηκαν με malloc    */
+   unsigned long releases;            /* Πλήθος αποδεσμεύσεων             */
+#endif
+};
+
+Arena globalArena;
+Arena unitArena;
+
+static Arena newArena (const char * name)
+{
+   Arena a = (Arena) new(sizeof(struct Arena_tag));
+
+   a->name    = name;
+   a->first   = NULL;
+   a->current = NULL;
+#ifdef DEBUG
+   a->allocs = a->bytes = a->blocks = a->releases = 0;
+#endif
+   return a;
+}
+
+void initArenas ()
+{
+   globalArena = newArena("global");
+   unitArena   = newArena("unit");
+}
+
+static ArenaBlock * newArenaBlock (Arena a, size_t size)
+{
+   ArenaBlock * b;
+
+   if (size < ARENA_BLOCK_SIZE)
+      size = ARENA_BLOCK_SIZE;
+   b = (ArenaBlock *) new(ARENA_ROUND(sizeof(ArenaBlock)) + size);
+   b->next = NULL;
+   b->size = size;
+   b->used = 0;
+   b->data = (char *) b + ARENA_ROUND(sizeof(ArenaBlock));
+#ifdef DEBUG
+   a->blocks++;
+#endif
+   return b;
+}
+
+void * arenaAlloc (Arena a, size_t size)
+{
+   ArenaBlock * b = a->current;
+   void       * result;
+
+   size = ARENA_ROUND(size);
+#ifdef DEBUG
+   a->allocs++;
+   a->bytes += size;
+#endif
+   if (b == NULL) {
+      if (a->first == NULL)
+         a->first = newArenaBlock(a, size);
+      b = a->first;
+      b->used = 0;
+   }
+   while (b->used + size > b->size) {
+      if (b->next == NULL)
+         b->next = newArenaBlock(a, size);
+      b = b->next;
+      b->used = 0;
+   }
+   a->current = b;
+   result = b->data + b->used;
+   b->used += size;
+   return result;
+}
+
+char * arenaStrdup (Arena a, const char * s)
+{
+   char * p = (char *) arenaAlloc(a, strlen(s) + 1);
+
+   strcpy(p, s);
+   return p;
+}
+
+ArenaMark arenaMark (Arena a)
+{
+   ArenaMark m;
+
+   m.block = a->current;
+   m.used  = (a->current == NULL) ? 0 : a->current->used;
+   return m;
+}
+
+/* Releases everything allocated after the mark was taken */
+void arenaRelease (Arena a, ArenaMark m)
+{
+   a->current = m.block;
+   if (m.block != NULL)
+      m.block->used = m.used;
+#ifdef DEBUG
+   a->releases++;
+#endif
+}
+
+#ifdef DEBUG
+void arenaStats (Arena a)
+{
+   printf("arena %s: %lu allocations, %lu bytes, %lu blocks, %lu releases\n",
+          a->name, a->allocs, a->bytes, a->blocks, a->releases);
+}
+#endif
+
+
 /* ---------------------------------------------------------------------
    ------- Αρχείο εισόδου του μεταγλωττιστή και αριθμός γραμμής --------
    --------------------------------------------------------------------- */
@@ -32,6 +32,37 @@ void * new    (size_t);
 void   delete (void *);
 
 
+/* ---------------------------------------------------------------------
+ * ------------------------- Arenas (our addition) ---------------------
+ * --------------------------------------------------------------------- */
+
+/* Bump-pointer allocation of objects that are never freed one by one.
+ * globalArena: objects that live until the end of the compilation (identifiers, types,
+ *              constants, functions and their parameters).
+ * unitArena:   objects of the unit being compiled (variables, temporaries, operands, 
+ *              lists). A mark is taken when a scope opens; in streaming mode everything 
+ *              allocated since is released together when the scope closes. */
+
+typedef struct Arena_tag * Arena;
+
+typedef struct {
+   struct ArenaBlock_tag * block;
+   size_t                  used;
+} ArenaMark;
+
+extern Arena globalArena;
+extern Arena unitArena;
+
+void      initArenas   (void);
+void *    arenaAlloc   (Arena a, size_t size);
+char *    arenaStrdup  (Arena a, const char * s);
+ArenaMark arenaMark    (Arena a);
+void      arenaRelease (Arena a, ArenaMark m);
+#ifdef DEBUG
+void      arenaStats   (Arena a);
+#endif
+
+
 /* ---------------------------------------------------------------------
    -------------- Καθολικές μεταβλητές του μεταγλωττιστή ---------------
    --------------------------------------------------------------------- */
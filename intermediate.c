@@ -19,9 +19,17 @@
 #include <string.h>
 
 #include "intermediate.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "valnum.h"
+#include "sccp.h"
+#include "regalloc.h"
+#include "slots.h"
+#include "licm.h"
 #include "general.h"
 #include "symbol.h"
 #include "error.h"
+#include "output.h"
 
 
 /* -------------------------------------------------------------
@@ -39,6 +47,16 @@ FILE *iout = NULL;
 Quad *q;
 static int qSize;
 
+/*
+ * Number of quads that have already been printed and recycled (streaming mode).
+ * The number of a quad as printed in the .imm and .asm files is quadBase + its
+ * position in q, so that labels remain unique among the units of the program.
+ */
+unsigned int quadBase = 0;
+
+/* Label operands of the quads of the unit, indexed by quad number (see oL()) */
+static Operand * labels;
+
 static struct Operand_tag operandConst [] = {
 	    { OPERAND_PASSMODE,	"V",	NULL },
 		{ OPERAND_PASSMODE,	"R",	NULL },
@@ -62,8 +80,46 @@ const Operand oRESULT =	&(operandConst[5]);
 
 void initIntermediate() 
 { 
+	int i;
 	qSize = QUAD_ARRAY_SIZE;
 	q = (Quad *) malloc(qSize * sizeof(Quad)); 
+	labels = (Operand *) new(qSize * sizeof(Operand));
+	for (i = 0; i < qSize; i++) labels[i] = NULL;
+}
+
+/* Operands are interned: each symbol has at most one operand of each kind (oS, oD, oA, oU),
+ * cached in SymbolEntry::operand, and each quad number one label operand (oL), cached in
+ * labels. So identical operands are pointer-equal and must never be modified.
+ * The operand of a symbol lives as long as the symbol itself: in unitArena for local variables
+ * and temporaries, in globalArena for everything else. Names are
+ * only formatted by operandName(), except for those of named symbols */
+static Operand symbolOperand(SymbolEntry * s, OperandType type, int slot)
+{
+	Operand o = s->operand[slot];
+	if (o != NULL) return o;
+	//non-local variables get their operand while an inner unit is compiled, after the mark of its scope
+	if ((s->entryType == ENTRY_VARIABLE || s->entryType == ENTRY_TEMPORARY) &&
+		currentScope != NULL && s->nestingLevel == currentScope->nestingLevel)
+		o = (Operand) arenaAlloc(unitArena, sizeof(struct Operand_tag));
+	else
+		o = (Operand) arenaAlloc(globalArena, sizeof(struct Operand_tag));
+	o->type = type;
+	o->name = (type == OPERAND_SYMBOL || type == OPERAND_UNIT) ? s->id : NULL;	//NULL for temporaries and constants
+	o->u.symbol = s;
+	s->operand[slot] = o;
+	return o;
+}
+
+//double the size of the quad array and of the label operands
+static void growQuads()
+{
+	fprintf(stderr, "quad limit reached\n");
+	int i;
+	qSize = 2 * qSize;
+	q = (Quad *) realloc(q, qSize * sizeof(Quad));	//double quad array size
+	labels = (Operand *) realloc(labels, qSize * sizeof(Operand));
+	if (q == NULL || labels == NULL) fatal("Out of memory");
+	for (i = qSize / 2; i < qSize; i++) labels[i] = NULL;
 }
 
 void genquad(OperatorType op,Operand x,Operand y,Operand z)
@@ -74,11 +130,32 @@ void genquad(OperatorType op,Operand x,Operand y,Operand z)
 	q[quadNext].y  = y;
 	q[quadNext].z  = z;
 	quadNext++;
-	if (quadNext == qSize) {
-		fprintf(stderr, "quad limit reached\n");
-		qSize = 2 * qSize;
-		q = (Quad *) realloc(q, qSize * sizeof(Quad));	//double quad array size
+	if (quadNext == qSize) growQuads();
+}
+
+/* For the optimizer: room for n quads before q[pos]. The quads from pos on (and the units that
+ * follow) move n places forward and their labels with them, so every jump still gets to the same
+ * quad. A label operand is shared by all the jumps to its quad, so it is renumbered in place.
+ * The new quads are removed (num -1) until the caller fills them */
+void insertQuads(int pos, int n)
+{
+	int i;
+	if (n <= 0) return;
+	if (pos < 1 || pos > quadNext) internal("insertQuads: no quad %d", pos);
+	while (quadNext + n >= qSize) growQuads();
+	memmove(&(q[pos + n]), &(q[pos]), (quadNext - pos) * sizeof(Quad));
+	memmove(&(labels[pos + n]), &(labels[pos]), (quadNext - pos + 1) * sizeof(Operand));
+	for (i = pos + n; i <= quadNext + n; i++) {
+		if (i < quadNext + n && ISACTIVE(q[i].num)) q[i].num = i;
+		if (labels[i] != NULL) labels[i]->u.quadLabel = i;
+	}
+	for (i = pos; i < pos + n; i++) {
+		q[i].num	= -1;
+		q[i].op		= O_ASSIGN;
+		q[i].x		= q[i].y = q[i].z = o_;
+		labels[i]	= NULL;
 	}
+	quadNext += n;
 }
 
 
@@ -87,70 +164,76 @@ void printQuads()
 	int i;
 	for (i = 1; i < quadNext; i++){
 		if (ISACTIVE(q[i].num)) 
-			fprintf(iout,"%d: %s, %s, %s, %s\n", q[i].num, otostr(q[i].op), q[i].x->name, q[i].y->name, q[i].z->name);
+			outFmt(immOut,"%d: %s, %s, %s, %s\n", quadBase + q[i].num, otostr(q[i].op), operandName(q[i].x), operandName(q[i].y), operandName(q[i].z));
 	}
 }
 
+/* Streaming mode: called after a unit has been printed. Its quads are recycled and quad
+ * numbering continues from where it stopped. Its operands are released by releaseScope() */
+void recycleQuads()
+{
+	int i;
+	for (i = 0; i <= quadNext; i++) labels[i] = NULL;
+	quadBase += quadNext - 1;
+	quadNext = 1;
+}
+
+
+/* Labels, dereferences, addresses and operands of temporaries and constants get no name (NULL),
+ * it is built by operandName() only if it is printed */
+const char * operandName(Operand o)
+{
+	static char buf[8][16];
+	static int next = 0;
+	char * p;
+	if (o->name != NULL) return o->name;
+	p = buf[next];
+	next = (next + 1) % 8;
+	switch (o->type) {
+		case OPERAND_QLABEL:		snprintf(p,16,"%d",quadBase + o->u.quadLabel);	return p;
+		case OPERAND_SYMBOL:		return entryName(o->u.symbol);
+		case OPERAND_DEREFERENCE:	snprintf(p,16,"[%s]",entryName(o->u.symbol));	return p;
+		case OPERAND_ADDRESS:		snprintf(p,16,"{%s}",entryName(o->u.symbol));	return p;
+		default:					internal("operandName: operand without name");
+	}
+	return NULL;
+}
 
 Operand oS(SymbolEntry * s)
 {
-	Operand o = (Operand ) new(sizeof(struct Operand_tag));
-	o->type	= OPERAND_SYMBOL;
-	o->name = s->id;
-	o->u.symbol	= s;
-	return o;
+	return symbolOperand(s, OPERAND_SYMBOL, 0);
 }
 
+//a label may refer to a quad not generated yet (evaluateCondition), beyond the end of the array
 Operand oL(int quadLabel)
 {
-	Operand o = (Operand ) new(sizeof(struct Operand_tag));
+	while (quadLabel >= qSize) growQuads();
+	Operand o = labels[quadLabel];
+	if (o != NULL) return o;
+	o = (Operand) arenaAlloc(unitArena, sizeof(struct Operand_tag));
 	o->type	= OPERAND_QLABEL;
-	char buf[12];		//12 = max letter of int
-	snprintf(buf,12,"%d",quadLabel);
-	o->name = strdup(buf);
+	o->name = NULL;
 	o->u.quadLabel = quadLabel;
+	labels[quadLabel] = o;
 	return o;
 }
 
 //called both on definition and on call of a function (block)
+//functions are in globalArena, so unit operands may be kept by parser after their unit (firstBlock, gcHungryFunc)
 Operand oU(SymbolEntry * s)
 {
-	#ifdef DEBUG
-	//printf("oU: %s\n", s->id);
-	#endif
 	if(s == NULL) internal("oU: function not declared in SymbolTable");
-	Operand o = (Operand ) new(sizeof(struct Operand_tag));
-	o->type = OPERAND_UNIT;
-	o->name = s->id;
-	o->u.symbol = s;
-	#ifdef DEBUG
-	//printf("oU: %s finished\n", s->id);
-	#endif
-	return o;
+	return symbolOperand(s, OPERAND_UNIT, 3);
 }
 
 Operand oD(SymbolEntry * s)
 {
-	Operand o = (Operand ) new(sizeof(struct Operand_tag));
-	o->type = OPERAND_DEREFERENCE;
-	int buf_size = 3+strlen(s->id);
-	char buf[buf_size];
-	snprintf(buf,buf_size,"[%s]",s->id);
-	o->name = strdup(buf);
-	o->u.symbol = s;
-	return o;
+	return symbolOperand(s, OPERAND_DEREFERENCE, 1);
 }
 
 Operand oA(SymbolEntry * s)
 {
-	Operand o = (Operand ) new(sizeof(struct Operand_tag));
-	o->type = OPERAND_ADDRESS;
-	int buf_size = 3+strlen(s->id);
-	char buf[buf_size];
-	snprintf(buf,buf_size,"{%s}",s->id);
-	o->name = strdup(buf);
-	o->u.symbol = s;
-	return o;
+	return symbolOperand(s, OPERAND_ADDRESS, 2);
 }
 
 
@@ -191,37 +274,75 @@ Operand evaluateCondition(List * TRUE, List * FALSE)
    ----------------------- Optimizations -----------------------
    ------------------------------------------------------------- */
 
-/* Optimizations 
-	1. inverse copy propagation
- 	2. constant propagation 
-	3. algebraic transformations
-	4. remove jumps to next instr
+/* Optimizations, run on every unit separately, over its control flow graph (cfg.c),
+ * by the pass manager below (name, lowest -O level)
+	0. removal of unreachable blocks, whenever the graph is built
+	1. sparse conditional constant propagation over SSA (sccp.c)	sccp, 2
+	2. inverse copy propagation										copyprop, 1
+	3. local value numbering (valnum.c)								valnum, 2
+ 	4. constant propagation 										fold, 1
+	5. algebraic transformations									algebraic, 1
+	6. loop invariant code motion (licm.c)							licm, 2
+	7. strength reduction of array indices in loops (licm.c)		induction, 2
+	8. booleans only tested by an ifb become jumps				fusebool, 1
+	9. jump threading and inversion of branches over jumps			threading, 1
+	10. remove jumps to next instr									jumps, 1
+	11. dead temporaries elimination								dce, 1
+	12. registers for word temporaries (regalloc.c)					regalloc, 1, once
+	13. sharing of stack slots among temporaries (slots.c)			slots, 1, once
 */
 
-static void opt_inverseCopyPropagation()
+//how many times every local of f is read in the unit
+static int * countReads(Flow f)
 {
-	int i;
-	//up to quadNext-2 because the quads that will be transformed always go in pairs
-	for (i = 1; i < quadNext-1; i++){
+	int i, k;
+	int * reads = (int *) new((f->symNum + 1) * sizeof(int));
+	for (k = 0; k < f->symNum; k++) reads[k] = 0;
+	for (i = f->g->first + 1; i < f->g->last; i++) {
 		if (!ISACTIVE(q[i].num)) continue;
+		if ((k = flowIndex(f, q[i].x)) >= 0) reads[k]++;
+		if ((k = flowIndex(f, q[i].y)) >= 0) reads[k]++;
+		if (q[i].z->type == OPERAND_DEREFERENCE && (k = flowIndex(f, q[i].z)) >= 0) reads[k]++;
+	}
+	return reads;
+}
+
+//t := x op y; z := t  becomes  z := x op y, only inside a block: if z := t is a jump target t may come from elsewhere
+//and only if t is read nowhere else (value numbering may have made it read more than once)
+static bool opt_inverseCopyPropagation(Cfg g)
+{
+	int i;
+	bool changed = false;
+	Flow f = newFlow(g);
+	int * reads = countReads(f);
+	//up to the quad before O_ENDU because the quads that will be transformed always go in pairs
+	for (i = g->first + 1; i < g->last - 1; i++){
+		if (!ISACTIVE(q[i].num) || !ISACTIVE(q[i+1].num)) continue;
+		if (BLOCK_OF(g,i) != BLOCK_OF(g,i+1)) continue;
 		OperatorType op1 = q[i].op;
 		OperatorType op2 = q[i+1].op;
 		if( (op1==O_ADD || op1==O_SUB || op1==O_MULT || op1==O_DIV || op1==O_MOD) && op2==O_ASSIGN ) {
-			if (getSymbol(q[i].z) == getSymbol(q[i+1].x) ) {
+			if (q[i].z == q[i+1].x && q[i].z->type==OPERAND_SYMBOL && getSymbol(q[i].z)->entryType==ENTRY_TEMPORARY &&
+				reads[flowIndex(f, q[i].z)] == 1) {		//operands are interned
 				q[i].z = q[i+1].z;
 				q[i+1].num = -1; //remove quad, deactivate
+				changed = true;
 				#ifdef DEBUG
 				printf("opt: inverseCopyPropagation: quad %d modified, quad %d removed\n", i, i+1);
 				#endif
 			}
 		}
 	}
+	delete(reads);
+	deleteFlow(f);
+	return changed;
 }
 
-static void opt_constantFolding()
+static bool opt_constantFolding(Cfg g)
 {
 	int i;
-	for (i = 1; i < quadNext; i++) {
+	bool changed = false;
+	for (i = g->first + 1; i < g->last; i++) {
 		if (!ISACTIVE(q[i].num)) continue;
 		OperatorType op = q[i].op;
 		if ( (op==O_ADD || op==O_SUB || op==O_MULT || op==O_DIV || op==O_MOD) && 
@@ -230,6 +351,7 @@ static void opt_constantFolding()
 			int v1 = getSymbol(q[i].x)->u.eConstant.value.vInteger;
 			int v2 = getSymbol(q[i].y)->u.eConstant.value.vInteger;
 			int res;
+			if ((op==O_DIV || op==O_MOD) && v2 == 0) continue;	//left to fail at run time
 			switch(op) {
 				case O_ADD:		res = v1 + v2;	break;
 				case O_SUB:		res = v1 - v2;	break;
@@ -240,62 +362,400 @@ static void opt_constantFolding()
 			q[i].op = O_ASSIGN;
 			q[i].x = oS(newConstant(NULL, typeInteger, res));
 			q[i].y = o_;
+			changed = true;
 		}
 	}
+	return changed;
 }
 
-static void opt_algebraicTransformations()
+static bool opt_algebraicTransformations(Cfg g)
 {
 	int i;
+	bool changed = false;
 	SymbolEntry * s;
-	for (i = 1 ; i < quadNext; i++){
+	for (i = g->first + 1; i < g->last; i++){
 		if(!ISACTIVE(q[i].num)) continue;
 		if(q[i].op==O_ADD) {
 			// 0 + x = x
 			s = getSymbol(q[i].x);
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==0)
-				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	changed = true;	continue;	}
 			// x + 0 = x
 			s = getSymbol(q[i].y);
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==0)
-				{ q[i].op=O_ASSIGN;	q[i].y=o_;					continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].y=o_;					changed = true;	continue;	}
 		}
 		else if(q[i].op==O_MULT) {
 			// 0 * x = 0
 			s = getSymbol(q[i].x);
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==0)
-				{ q[i].op=O_ASSIGN;	q[i].y=o_;					continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].y=o_;					changed = true;	continue;	}
 			// 1 * x = x
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==1)
-				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	changed = true;	continue;	}
 			s = getSymbol(q[i].y);
 			// x * 0 = 0
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==0)
-				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].x=q[i].y;	q[i].y=o_;	changed = true;	continue;	}
 			// x * 1 = x
 			if(s->entryType==ENTRY_CONSTANT && s->u.eConstant.value.vInteger==1)
-				{ q[i].op=O_ASSIGN;	q[i].y=o_;					continue;	}
+				{ q[i].op=O_ASSIGN;	q[i].y=o_;					changed = true;	continue;	}
 		}
 	}
+	return changed;
 }
 
 //ommits jumps to the following quad (flow will get there anyway)
-static void opt_oneStepJumps()
+static bool opt_oneStepJumps(Cfg g)
 {	
 	int i;
-	for (i = 1 ; i < quadNext; i++){
+	bool changed = false;
+	for (i = g->first + 1; i < g->last; i++){
 		if (!ISACTIVE(q[i].num)) continue;
-		if (q[i].op==O_JUMP && q[i].z->u.quadLabel==i+1) 
+		if (q[i].op==O_JUMP && q[i].z->u.quadLabel==i+1) {
+			q[i].num = -1;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+//first quad from q[i] on that is not removed: where control gets if it goes to q[i]
+static int nextActive(Cfg g, int i)
+{
+	while (i < g->last && !ISACTIVE(q[i].num)) i++;
+	return i;
+}
+
+//targeted[i - first]: some jump gets to q[i]
+static bool * jumpTargets(Cfg g)
+{
+	int i, t;
+	bool * targeted = (bool *) new((g->last - g->first + 1) * sizeof(bool));
+	for (i = 0; i <= g->last - g->first; i++) targeted[i] = false;
+	for (i = g->first + 1; i < g->last; i++)
+		if (ISACTIVE(q[i].num) && (t = jumpTarget(i)) >= 0) targeted[nextActive(g, t) - g->first] = true;
+	return targeted;
+}
+
+//where control gets if it goes to q[i], following jumps (bounded, a loop of jumps never ends)
+static int finalTarget(Cfg g, int i)
+{
+	int steps;
+	i = nextActive(g, i);
+	for (steps = g->last - g->first; steps > 0 && q[i].op == O_JUMP && jumpTarget(i) >= 0; steps--)
+		i = nextActive(g, jumpTarget(i));
+	return i;
+}
+
+/* Every jump goes straight to the end of a chain of jumps. Then a branch over a jump,
+ *		relop x, y, L1; jump L2; L1: ...
+ * becomes the opposite branch to L2 (ifb x becomes = x, false) and a branch or jump to where
+ * control falls anyway is removed */
+static bool opt_jumpThreading(Cfg g)
+{
+	int i, j, t;
+	bool changed = false;
+	bool * targeted;
+	for (i = g->first + 1; i < g->last; i++) {
+		if (!ISACTIVE(q[i].num) || (t = jumpTarget(i)) < 0) continue;
+		j = finalTarget(g, t);
+		if (j != t) {
+			q[i].z = oL(j);
+			changed = true;
+			#ifdef DEBUG
+			printf("opt: jumpThreading: quad %d jumps to %d instead of %d\n", i, j, t);
+			#endif
+		}
+	}
+	targeted = jumpTargets(g);
+	for (i = g->first + 1; i < g->last; i++) {
+		if (!ISACTIVE(q[i].num) || (t = jumpTarget(i)) < 0) continue;
+		t = nextActive(g, t);
+		j = nextActive(g, i + 1);
+		if (t == j) {
 			q[i].num = -1;
+			changed = true;
+			continue;
+		}
+		if (!ISBRANCH(q[i].op) || q[j].op != O_JUMP || jumpTarget(j) < 0 || targeted[j - g->first]) continue;
+		if (t != nextActive(g, j + 1)) continue;
+		switch (q[i].op) {
+			case O_EQ:	q[i].op = O_NE;	break;
+			case O_NE:	q[i].op = O_EQ;	break;
+			case O_LT:	q[i].op = O_GE;	break;
+			case O_GE:	q[i].op = O_LT;	break;
+			case O_GT:	q[i].op = O_LE;	break;
+			case O_LE:	q[i].op = O_GT;	break;
+			default:	//O_IFB
+				q[i].op = O_EQ;
+				q[i].y	= oS(newConstant("false", typeBoolean, false));
+				break;
+		}
+		q[i].z = q[j].z;
+		q[j].num = -1;
+		changed = true;
+		#ifdef DEBUG
+		printf("opt: jumpThreading: quad %d inverted, quad %d removed\n", i, j);
+		#endif
+	}
+	delete(targeted);
+	return changed;
+}
+
+//q[i] is t := true or t := false: returns the constant, else NULL
+static SymbolEntry * booleanDef(int i, Operand t)
+{
+	SymbolEntry * c;
+	if (q[i].op != O_ASSIGN || q[i].z != t || q[i].x->type != OPERAND_SYMBOL) return NULL;
+	c = getSymbol(q[i].x);
+	return (c->entryType == ENTRY_CONSTANT && getType(c)->kind == TYPE_BOOLEAN) ? c : NULL;
+}
+
+static void setQuad(int i, OperatorType op, Operand x, Operand y, Operand z)
+{
+	q[i].num	= i;
+	q[i].op		= op;
+	q[i].x		= x;
+	q[i].y		= y;
+	q[i].z		= z;
+}
+
+/* A condition that evaluateCondition() turned into a temporary only for createCondition() to test it:
+ *		L1: t := true; jump L3;  L2: t := false;  L3: [z := t;] ifb t (or z), L
+ * Every predecessor of the block of the ifb gives t a constant, so the ones that jump there do the
+ * copies of t themselves and jump on to L or past the ifb. The one that falls through keeps the
+ * block, with the constant in place of t, so the ifb becomes a jump or nothing. The temporary is
+ * left with no assignments. Blocks that the new jumps reach are left for the next round */
+static bool opt_fuseBooleans(Cfg g)
+{
+	int b, i, j, k, n, d, e, copies, fall, taken, past;
+	bool changed = false, ok;
+	Operand t;
+	SymbolEntry * c;
+	Flow f = newFlow(g);
+	int * reads = countReads(f);
+	bool * targeted = jumpTargets(g);
+	bool * dirty = (bool *) new(g->blockNum * sizeof(bool));
+	int * defs = (int *) new((g->blockNum + 1) * sizeof(int));		//per predecessor: the quad that assigns t
+	for (b = 0; b < g->blockNum; b++) dirty[b] = false;
+	for (b = 0; b < g->blockNum; b++) {
+		Block * p = &(g->block[b]);
+		if (!p->reachable || dirty[b] || p->predNum == 0 || (k = lastActive(p)) < 0 || q[k].op != O_IFB || jumpTarget(k) < 0) continue;
+		//the block holds only copies of t and the ifb, of t or of a copy
+		t = q[k].x;
+		copies = 0;
+		ok = true;
+		for (i = p->first; i < k && ok; i++) {
+			if (!ISACTIVE(q[i].num)) continue;
+			if (copies++ == 0) t = q[i].x;
+			ok = q[i].op == O_ASSIGN && q[i].x == t && q[i].z != t;
+		}
+		if (!ok || t->type != OPERAND_SYMBOL || getSymbol(t)->entryType != ENTRY_TEMPORARY || flowIndex(f, t) < 0) continue;
+		n = (q[k].x == t) ? 1 : 0;
+		for (i = p->first; i < k; i++)
+			if (ISACTIVE(q[i].num) && q[i].z == q[k].x) n++;
+		if (n == 0 || reads[flowIndex(f, t)] != copies + (q[k].x == t ? 1 : 0)) continue;
+		//every predecessor ends with t := c, then jumps here (room for the copies and a jump) or falls through
+		fall = -1;
+		for (j = 0; j < p->predNum && ok; j++) {
+			Block * pp = &(g->block[p->pred[j]]);
+			if ((e = lastActive(pp)) < 0) { ok = false; break; }
+			if (q[e].op == O_JUMP) {
+				for (d = e - 1; d >= pp->first && !ISACTIVE(q[d].num); d--) ;
+				ok = d >= pp->first && booleanDef(d, t) != NULL && !targeted[e - g->first] && e - d >= copies;
+			}
+			else {
+				d = e;
+				ok = booleanDef(d, t) != NULL && pp->succ[0] == b;
+				fall = j;
+			}
+			defs[j] = d;
+		}
+		if (!ok) continue;
+		taken	= nextActive(g, jumpTarget(k));
+		past	= nextActive(g, k + 1);
+		if (BLOCK_OF(g, taken) == b) continue;		//t is read again on the way
+		for (j = 0; j < p->predNum; j++) {
+			if (j == fall) continue;
+			d = defs[j];
+			e = lastActive(&(g->block[p->pred[j]]));
+			c = booleanDef(d, t);
+			n = d;
+			for (i = p->first; i < k; i++)
+				if (ISACTIVE(q[i].num)) setQuad(n++, O_ASSIGN, oS(c), o_, q[i].z);
+			setQuad(n++, O_JUMP, o_, o_, oL(c->u.eConstant.value.vBoolean ? taken : past));
+			for (; n <= e; n++) q[n].num = -1;
+		}
+		if (fall >= 0) {
+			c = booleanDef(defs[fall], t);
+			q[defs[fall]].num = -1;
+			for (i = p->first; i < k; i++)
+				if (ISACTIVE(q[i].num)) q[i].x = oS(c);
+			if (c->u.eConstant.value.vBoolean) {
+				q[k].op	= O_JUMP;
+				q[k].x	= o_;
+			}
+			else
+				q[k].num = -1;
+		}
+		targeted[taken - g->first] = targeted[past - g->first] = true;
+		dirty[BLOCK_OF(g, taken)] = dirty[BLOCK_OF(g, past)] = true;
+		changed = true;
+		#ifdef DEBUG
+		printf("opt: fuseBooleans: ifb %d fused into %d predecessors\n", k, p->predNum);
+		#endif
+	}
+	delete(defs);
+	delete(dirty);
+	delete(targeted);
+	delete(reads);
+	deleteFlow(f);
+	return changed;
+}
+
+/* Quads that compute a temporary that is never read again are removed. Their operands may
+ * become dead too, in the same block at once (backwards), in other blocks in the next round */
+static bool opt_deadTemporaries(Cfg g)
+{
+	int b, i, d;
+	bool changed = true, removed = false;
+	while (changed) {
+		changed = false;
+		Flow f = newFlow(g);
+		computeLiveness(f);
+		Set live = newSet(f);
+		for (b = 0; b < g->blockNum; b++) {
+			if (!g->block[b].reachable) continue;
+			setCopy(f, live, f->liveOut[b]);
+			for (i = g->block[b].last; i >= g->block[b].first; i--) {
+				if (!ISACTIVE(q[i].num)) continue;
+				OperatorType op = q[i].op;
+				d = quadDef(f, i);
+				if ((op==O_ASSIGN || op==O_ARRAY || op==O_ADD || op==O_SUB || op==O_MULT || op==O_DIV || op==O_MOD) &&
+					d >= 0 && f->sym[d]->entryType == ENTRY_TEMPORARY && !SET_HAS(live, d)) {
+					q[i].num = -1;
+					changed = removed = true;
+					#ifdef DEBUG
+					printf("opt: deadTemporaries: quad %d removed\n", i);
+					#endif
+					continue;
+				}
+				liveStep(f, i, live);
+			}
+		}
+		delete(live);
+		deleteFlow(f);
+	}
+	return removed;
+}
+
+/* -------------------------------------------------------------
+   ----------------------- Pass manager ------------------------
+   ------------------------------------------------------------- */
+
+/* The passes run in this order, in rounds, until a round changes nothing or the rounds of the
+ * level are over. Every pass returns whether it changed some quad. A pass that may change the
+ * blocks (removes or redirects jumps) is followed by a new control flow graph.
+ * The passes marked once run after the rounds, in order, one time each */
+typedef struct Pass_tag {
+	const char *	name;			//for -fno-<name>
+	bool			(*run)(Cfg g);
+	int				level;			//lowest -O level that runs it
+	bool			blocks;			//may change the blocks of the unit
+	bool			once;			//after the rounds
+	bool			enabled;
+} Pass;
+
+static Pass passes[] = {
+	{ "sccp",		sccp,							2, true,	false,	true },
+	{ "copyprop",	opt_inverseCopyPropagation,		1, false,	false,	true },	//before folding, or folding misses t := c op c; z := t
+	{ "valnum",		valueNumbering,					2, false,	false,	true },
+	{ "fold",		opt_constantFolding,			1, false,	false,	true },
+	{ "algebraic",	opt_algebraicTransformations,	1, false,	false,	true },
+	{ "licm",		hoistInvariants,				2, true,	false,	true },	//inserts quads
+	{ "induction",	reduceInductions,				2, true,	false,	true },	//inserts quads and temporaries
+	{ "fusebool",	opt_fuseBooleans,				1, true,	false,	true },
+	{ "threading",	opt_jumpThreading,				1, true,	false,	true },
+	{ "jumps",		opt_oneStepJumps,				1, false,	false,	true },
+	{ "dce",		opt_deadTemporaries,			1, false,	false,	true },
+	{ "regalloc",	allocateRegisters,				1, false,	true,	true },	//the quads are final, before the slots
+	{ "slots",		shareSlots,						1, false,	true,	true },	//the frame: once the quads are final
+};
+
+#define PASS_NUM	((int) (sizeof(passes) / sizeof(Pass)))
+
+static int	optLevel = 0;
+static const int maxRounds[] = { 0, 1, 4, 16 };	//per level
+
+void setOptLevel(int level)
+{
+	if (level < 0 || level > OPT_LEVEL_MAX) fatal("unknown optimization level -O%d", level);
+	optLevel = level;
+}
+
+int getOptLevel()
+{
+	return optLevel;
+}
+
+bool disablePass(const char * name)
+{
+	int i;
+	for (i = 0; i < PASS_NUM; i++)
+		if (!strcmp(passes[i].name, name)) {
+			passes[i].enabled = false;
+			return true;
+		}
+	return false;
+}
+
+static Cfg unitCfg(int first, int last)
+{
+	Cfg g = buildCfg(first, last);
+	removeUnreachable(g);
+	return g;
+}
+
+//a pass may insert quads (licm), so the end of the unit is found again every time
+static void optimizeUnit(int first)
+{
+	Cfg g = unitCfg(first, unitEnd(first));
+	int round, i;
+	bool changed = true;
+	for (round = 0; round < maxRounds[optLevel] && changed; round++) {
+		changed = false;
+		for (i = 0; i < PASS_NUM; i++) {
+			if (passes[i].once || !passes[i].enabled || passes[i].level > optLevel) continue;
+			if (!passes[i].run(g)) continue;
+			changed = true;
+			#ifdef DEBUG
+			printf("opt: round %d: %s changed unit of quads %d-%d\n", round, passes[i].name, first, unitEnd(first));
+			#endif
+			if (passes[i].blocks) {
+				deleteCfg(g);
+				g = unitCfg(first, unitEnd(first));
+			}
+		}
 	}
+	for (i = 0; i < PASS_NUM; i++)
+		if (passes[i].once && passes[i].enabled && passes[i].level <= optLevel && passes[i].run(g) && passes[i].blocks) {
+			deleteCfg(g);
+			g = unitCfg(first, unitEnd(first));
+		}
+	deleteCfg(g);
 }
 
+//the quads may contain many units (not in streaming mode), they never overlap
 void optimize()
 {	
-	opt_inverseCopyPropagation(); //first, if constantFolding first, it will not work
-	opt_constantFolding();
-	opt_algebraicTransformations();
-	opt_oneStepJumps();
+	int i;
+	if (optLevel == 0) return;
+	for (i = 1; i < quadNext; i++)
+		if (q[i].op == O_UNIT) {
+			optimizeUnit(i);
+			i = unitEnd(i);
+		}
 }
 
 
@@ -305,15 +765,15 @@ void optimize()
 
 List* emptylist()
 {
-	List *l = (List *)new(sizeof(List));
+	List *l = (List *)arenaAlloc(unitArena, sizeof(List));
 	l->head = NULL;
 	return l;
 }
 
 List* makelist(int qnum)
 {
-	List *l = (List *)new(sizeof(List));
-	Node *n = (Node *)new(sizeof(Node));
+	List *l = (List *)arenaAlloc(unitArena, sizeof(List));
+	Node *n = (Node *)arenaAlloc(unitArena, sizeof(Node));
 	n->data = qnum;
 	n->next = NULL;
 	l->head = n;
@@ -334,19 +794,15 @@ void backpatch(List *l,int qnum)
 {
 	Operand dest = oL(qnum);
 	Node * p = l->head;
-	Node * t;
 	while(p!=NULL){
 		int index = p->data;
 		Quad qd = q[index];
 		if(qd.x==oSTAR) q[index].x = dest;	
 		if(qd.y==oSTAR) q[index].y = dest;	
 		if(qd.z==oSTAR) q[index].z = dest;	
-		/* As we traverse we delete the elements of the list */
-		t=p;
 		p=p->next;
-		delete(t);
 	}
-	l->head=NULL; //list has been emptied
+	l->head=NULL; //list has been emptied, its nodes are released with unitArena
 }
 
 
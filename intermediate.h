@@ -28,6 +28,10 @@
 //checks if after optimization a quad remains present (active) and has not been deleted
 #define ISACTIVE(NUM) ((NUM)<0 ? false : true)
 
+//highest optimization level, -O alone is -O2
+#define OPT_LEVEL_MAX 3
+#define OPT_LEVEL_DEFAULT 2
+
 /* ---------------------------------------------------------------------
    --------------------------- Ορισμός τύπων ---------------------------
    --------------------------------------------------------------------- */
@@ -118,6 +122,7 @@ typedef struct ListPair_tag {
 extern FILE *		iout;
 
 extern Quad			*q;
+extern unsigned int	quadBase;
 
 extern const Operand oR  ; 
 extern const Operand oV  ;
@@ -133,10 +138,16 @@ extern const Operand oRESULT;
 /* Interface to parser */
 
 void	printQuads	(void);
-void	optimize	(void);
+void	optimize	(void);		/* runs the passes of the optimization level on every unit of q */
+void	setOptLevel	(int level);	/* -O0 (default) ... -O<OPT_LEVEL_MAX> */
+int		getOptLevel	(void);
+bool	disablePass	(const char * name);	/* -fno-<name>, returns false if there is no such pass */
 void	initIntermediate (void);
+void	recycleQuads (void);	/* streaming mode: recycle quads and operands of the unit just printed */
+const char * operandName (Operand o);	/* printable name of an operand, built lazily for temporaries */
 
 void	genquad		(OperatorType op,Operand x,Operand y,Operand z);
+void	insertQuads	(int pos, int n);	/* optimizer: n removed quads before q[pos], the rest move forward */
 
 List*	emptylist	(void);
 List*	makelist	(int qnum);
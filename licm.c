@@ -0,0 +1,515 @@
+/******************************************************************************
+
+ *  C code file   : licm.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Loop invariant code motion and strength reduction
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "licm.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   --------------------------- Loops ---------------------------
+   ------------------------------------------------------------- */
+
+typedef struct Loop_tag {
+	int		header;
+	bool *	in;			//in[b]: block b belongs to the loop
+	int		size;		//number of blocks
+} Loop;
+
+//the blocks that reach the source of a back edge without going through the header
+static void addBackEdge(Cfg g, Loop * l, int from, int * stack)
+{
+	int top = 0, b, j;
+	if (l->in[from]) return;
+	l->in[from] = true;
+	l->size++;
+	stack[top++] = from;
+	while (top > 0) {
+		b = stack[--top];
+		for (j = 0; j < g->block[b].predNum; j++) {
+			int p = g->block[b].pred[j];
+			if (l->in[p] || !g->block[p].reachable) continue;
+			l->in[p] = true;
+			l->size++;
+			stack[top++] = p;
+		}
+	}
+}
+
+//one loop per header, the back edges to the same header share it. Sorted inner first (fewer blocks)
+static Loop * findLoops(Cfg g, int * loopNum)
+{
+	Loop * loops = (Loop *) new((g->blockNum + 1) * sizeof(Loop));
+	int * stack = (int *) new(g->blockNum * sizeof(int));
+	int b, t, h, k, n = 0;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!g->block[b].reachable) continue;
+		for (t = 0; t < 2; t++) {
+			h = g->block[b].succ[t];
+			if (h < 0 || !dominates(g, h, b)) continue;
+			for (k = 0; k < n && loops[k].header != h; k++) ;
+			if (k == n) {
+				loops[n].header	= h;
+				loops[n].in		= (bool *) new(g->blockNum * sizeof(bool));
+				memset(loops[n].in, 0, g->blockNum * sizeof(bool));
+				loops[n].in[h]	= true;
+				loops[n].size	= 1;
+				n++;
+			}
+			addBackEdge(g, &(loops[k]), b, stack);
+		}
+	}
+	delete(stack);
+	for (b = 1; b < n; b++) {
+		Loop l = loops[b];
+		for (k = b; k > 0 && loops[k - 1].size > l.size; k--) loops[k] = loops[k - 1];
+		loops[k] = l;
+	}
+	*loopNum = n;
+	return loops;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Invariants ------------------------
+   ------------------------------------------------------------- */
+
+/* Library functions whose result depends only on their arguments, and on the contents of the
+ * arrays they get for the ones that read memory */
+static const struct {
+	const char *	name;
+	bool			readsMemory;
+} pureFunctions[] = {
+	{ "abs",	false },
+	{ "ord",	false },
+	{ "chr",	false },
+	{ "strlen",	true },
+	{ "strcmp",	true },
+};
+
+#define PURE_NUM	((int) (sizeof(pureFunctions) / sizeof(pureFunctions[0])))
+
+//index in pureFunctions of the function called by q[i], -1 if none
+static int pureCall(int i)
+{
+	SymbolEntry * s = getSymbol(q[i].z);
+	int k;
+	if (!isLibFunc(s)) return -1;
+	for (k = 0; k < PURE_NUM; k++)
+		if (!strcmp(s->id, pureFunctions[k].name)) return k;
+	return -1;
+}
+
+//state of the loop being examined
+static Cfg		g;
+static Flow		f;
+static Loop *	loop;
+static int *	writes;		//per local: quads of the loop that may write it
+static int *	defQuad;	//per local written once: the quad
+static bool		memWrites;	//the loop may write memory (non-locals, [x], arrays, by reference)
+static bool *	hoisted;	//hoisted[i - first]: q[i] moves to the preheader
+
+static void addWrite(int k, int i)
+{
+	if (k < 0) return;
+	writes[k]++;
+	defQuad[k] = i;
+}
+
+//what the quads of the loop write
+static void loopWrites()
+{
+	int b, i, k;
+	memWrites = false;
+	for (k = 0; k < f->symNum; k++) writes[k] = 0;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!loop->in[b]) continue;
+		for (i = g->block[b].first; i <= g->block[b].last; i++) {
+			if (!ISACTIVE(q[i].num)) continue;
+			switch (q[i].op) {
+				case O_ASSIGN: case O_ARRAY:
+				case O_ADD: case O_SUB: case O_MULT: case O_DIV: case O_MOD:
+					if ((k = quadDef(f, i)) >= 0) addWrite(k, i);
+					else memWrites = true;
+					break;
+				case O_PAR:
+					if (q[i].y == oV) break;
+					if (q[i].x->type == OPERAND_SYMBOL && (k = flowIndex(f, q[i].x)) >= 0) addWrite(k, i);
+					else memWrites = true;
+					break;
+				case O_CALL:
+					if (pureCall(i) >= 0) break;
+					memWrites = true;
+					if (getSymbol(q[i].z)->nestingLevel >= f->level)	//declared in the unit: may write its variables
+						for (k = 0; k < f->symNum; k++)
+							if (SET_HAS(f->vars, k)) writes[k] += 2;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+//the operand has the same value on every iteration, if the quads marked so far are hoisted
+static bool invariantOperand(Operand o, bool * readsMemory)
+{
+	SymbolEntry * e;
+	int k;
+	switch (o->type) {
+		case OPERAND_NULL:
+			return true;
+		case OPERAND_DEREFERENCE:
+			if (memWrites) return false;
+			*readsMemory = true;
+			//falls through: the pointer itself
+		case OPERAND_SYMBOL:
+			e = getSymbol(o);
+			if (e->entryType == ENTRY_CONSTANT) return true;
+			if ((k = flowIndex(f, o)) < 0) return !memWrites;
+			return writes[k] == 0 || (writes[k] == 1 && hoisted[defQuad[k] - g->first]);
+		default:
+			return false;
+	}
+}
+
+/* q[i] is the only quad of the loop that writes local k. Its value replaces the old one of k
+ * everywhere: in the loop it is read only after q[i] (k is not live at the header) and after the
+ * loop only if q[i] runs before every exit where k is live. The exits of a loop that may run no
+ * times are always in its header, where nothing but the header dominates them */
+static bool hoistableDef(int i, int k)
+{
+	int b, t, s;
+	if (k < 0 || writes[k] != 1 || SET_HAS(f->liveIn[loop->header], k)) return false;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!loop->in[b]) continue;
+		for (t = 0; t < 2; t++) {
+			s = g->block[b].succ[t];
+			if (s >= 0 && !loop->in[s] && SET_HAS(f->liveIn[s], k) && !dominates(g, BLOCK_OF(g, i), b)) return false;
+		}
+	}
+	return true;
+}
+
+//q[i] runs before every exit of the loop: needed to read memory that may not be there otherwise
+static bool beforeExits(int i)
+{
+	int b, t, s;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!loop->in[b]) continue;
+		for (t = 0; t < 2; t++) {
+			s = g->block[b].succ[t];
+			if (s >= 0 && !loop->in[s] && !dominates(g, BLOCK_OF(g, i), b)) return false;
+		}
+	}
+	return true;
+}
+
+//arithmetic and array addresses: division may fail and must stay where it is
+static bool invariantQuad(int i)
+{
+	OperatorType op = q[i].op;
+	bool readsMemory = false;
+	if (op != O_ASSIGN && op != O_ARRAY && op != O_ADD && op != O_SUB && op != O_MULT) return false;
+	if (!invariantOperand(q[i].x, &readsMemory) || !invariantOperand(q[i].y, &readsMemory)) return false;
+	if (!hoistableDef(i, quadDef(f, i))) return false;
+	return !readsMemory || beforeExits(i);
+}
+
+/* The call of a pure function in q[c] and the par quads before it, all of them or nothing.
+ * Returns the first quad of the call, -1 if it is not invariant */
+static int invariantCall(int c)
+{
+	int p = pureCall(c), i, first = c;
+	bool readsMemory = (p >= 0) && pureFunctions[p].readsMemory;
+	if (p < 0 || (readsMemory && memWrites)) return -1;
+	for (i = c - 1; i >= g->block[BLOCK_OF(g, c)].first; i--) {
+		if (!ISACTIVE(q[i].num)) continue;
+		if (q[i].op != O_PAR) break;
+		if (q[i].y == oV && !invariantOperand(q[i].x, &readsMemory)) return -1;
+		if (q[i].y == oRET && !hoistableDef(i, quadDef(f, i))) return -1;
+		if (q[i].y == oR) return -1;
+		first = i;
+	}
+	return (!readsMemory || beforeExits(c)) ? first : -1;
+}
+
+/* The quads to hoist, in the order they are marked: every one is marked after the ones that
+ * write its operands. Returns their number */
+static int invariants(int * hoist)
+{
+	int b, i, j, n = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (b = 0; b < g->blockNum; b++) {
+			if (!loop->in[b]) continue;
+			for (i = g->block[b].first; i <= g->block[b].last; i++) {
+				if (!ISACTIVE(q[i].num) || hoisted[i - g->first]) continue;
+				if (q[i].op == O_CALL) {
+					if ((j = invariantCall(i)) < 0) continue;
+					for (; j <= i; j++)
+						if (ISACTIVE(q[j].num)) {
+							hoisted[j - g->first] = true;
+							hoist[n++] = j;
+						}
+					changed = true;
+				}
+				else if (invariantQuad(i)) {
+					hoisted[i - g->first] = true;
+					hoist[n++] = i;
+					changed = true;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Preheader -------------------------
+   ------------------------------------------------------------- */
+
+/* Opens room for n quads before the first quad of the header and returns the first of them.
+ * The entries that jump to the header jump there instead, the one that falls through gets there
+ * anyway and the back edges keep their label, which moves with the header */
+static int openPreheader(int n)
+{
+	int pos = g->block[loop->header].first;
+	int i, k, entryNum = 0;
+	int * entries = (int *) new((g->last - g->first + 1) * sizeof(int));
+	for (i = g->first + 1; i < g->last; i++)
+		if (ISACTIVE(q[i].num) && jumpTarget(i) == pos && !loop->in[BLOCK_OF(g, i)]) entries[entryNum++] = i;
+	insertQuads(pos, n);
+	for (k = 0; k < entryNum; k++) {
+		i = entries[k] + (entries[k] >= pos ? n : 0);
+		q[i].z = oL(pos);
+	}
+	#ifdef DEBUG
+	printf("opt: loops: preheader %d-%d before the loop at %d (%d entries jump there)\n", pos, pos + n - 1, pos + n, entryNum);
+	#endif
+	delete(entries);
+	return pos;
+}
+
+//the block before the header falls through into it from inside the loop: no room for a preheader there
+static bool latchFallsThrough()
+{
+	int p = loop->header - 1, last;
+	if (!loop->in[p]) return false;
+	last = lastActive(&(g->block[p]));
+	return last < 0 || (q[last].op != O_JUMP && q[last].op != O_RET);
+}
+
+/* Runs transform on the loops of the unit, inner first, until it changes one of them, and
+ * returns whether it did. The state of the loop is set for transform */
+static bool transformLoop(Cfg cfg, bool (*transform)(void))
+{
+	int loopNum, k;
+	bool done = false;
+	Loop * loops;
+	g = cfg;
+	computeDominators(g);
+	loops = findLoops(g, &loopNum);
+	if (loopNum == 0) {
+		delete(loops);
+		return false;
+	}
+	f = newFlow(g);
+	computeLiveness(f);
+	writes	= (int *) new((f->symNum + 1) * sizeof(int));
+	defQuad	= (int *) new((f->symNum + 1) * sizeof(int));
+	hoisted	= (bool *) new((g->last - g->first + 1) * sizeof(bool));
+	for (k = 0; k < loopNum && !done; k++) {
+		loop = &(loops[k]);
+		if (latchFallsThrough()) continue;
+		memset(hoisted, 0, (g->last - g->first + 1) * sizeof(bool));
+		loopWrites();
+		done = transform();
+	}
+	for (k = 0; k < loopNum; k++) delete(loops[k].in);
+	delete(loops);
+	delete(writes);
+	delete(defQuad);
+	delete(hoisted);
+	deleteFlow(f);
+	return done;
+}
+
+//loop after loop, with a new graph every time, as the quads have moved
+static bool everyLoop(Cfg cfg, bool (*transform)(void))
+{
+	int first = cfg->first;
+	bool changed = false;
+	Cfg own = NULL;
+	while (transformLoop(cfg, transform)) {
+		changed = true;
+		deleteCfg(own);
+		cfg = own = buildCfg(first, unitEnd(first));
+	}
+	deleteCfg(own);
+	return changed;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Transforms ------------------------
+   ------------------------------------------------------------- */
+
+//the invariants of the loop move to its preheader
+static bool hoistOut()
+{
+	int * hoist = (int *) new((g->last - g->first + 1) * sizeof(int));
+	int n = invariants(hoist), k, pos;
+	Quad * moved = (Quad *) new((n + 1) * sizeof(Quad));
+	for (k = 0; k < n; k++) {
+		moved[k] = q[hoist[k]];
+		q[hoist[k]].num = -1;
+	}
+	if (n > 0) {
+		pos = openPreheader(n);
+		for (k = 0; k < n; k++) {
+			q[pos + k] = moved[k];
+			q[pos + k].num = pos + k;
+		}
+		#ifdef DEBUG
+		printf("opt: licm: %d quads hoisted\n", n);
+		#endif
+	}
+	delete(moved);
+	delete(hoist);
+	return n > 0;
+}
+
+//local k changes in the loop only by k := k + c or k := k - c: returns c (negative for -), else 0
+static int inductionStep(int k)
+{
+	int d = defQuad[k];
+	Operand c;
+	SymbolEntry * e;
+	if (writes[k] != 1) return 0;
+	if (q[d].op == O_ADD && q[d].x == q[d].z)		c = q[d].y;
+	else if (q[d].op == O_ADD && q[d].y == q[d].z)	c = q[d].x;
+	else if (q[d].op == O_SUB && q[d].x == q[d].z)	c = q[d].y;
+	else return 0;
+	if (c->type != OPERAND_SYMBOL) return 0;
+	e = getSymbol(c);
+	if (e->entryType != ENTRY_CONSTANT || getType(e)->kind != TYPE_INTEGER) return 0;
+	return (short) ((q[d].op == O_SUB ? -1 : 1) * e->u.eConstant.value.vInteger);
+}
+
+//a pointer that runs along an array together with an induction variable
+typedef struct Pointer_tag {
+	Operand			array;
+	int				iv;		//local k of the induction variable
+	SymbolEntry *	p;
+} Pointer;
+
+/* Strength reduction: for every induction variable i of the loop (inductionStep) and every
+ * array a that the loop does not assign,
+ *		array, a, i, t		becomes		:=, p, -, t
+ * with p := a[i] in the preheader and p := p + c*size right after the quad that changes i, so
+ * that p is always the address of a[i] and the multiplication of the index is gone */
+static bool reduceStrength()
+{
+	SymbolEntry * func = getSymbol(q[g->first].x);
+	Pointer * ptr = (Pointer *) new((g->last - g->first + 1) * sizeof(Pointer));
+	int * step = (int *) new((f->symNum + 1) * sizeof(int));
+	int header = g->block[loop->header].first;
+	int b, i, j, k, n = 0, pos, last, count;
+	bool readsMemory;
+	for (k = 0; k < f->symNum; k++) {
+		step[k] = inductionStep(k);
+		if (step[k] != 0 && defQuad[k] < header) step[k] = 0;	//no room right after it
+	}
+	for (b = 0; b < g->blockNum; b++) {
+		if (!loop->in[b]) continue;
+		for (i = g->block[b].first; i <= g->block[b].last; i++) {
+			if (!ISACTIVE(q[i].num) || q[i].op != O_ARRAY || q[i].y->type != OPERAND_SYMBOL) continue;
+			if ((k = flowIndex(f, q[i].y)) < 0 || step[k] == 0) continue;
+			readsMemory = false;
+			if (!invariantOperand(q[i].x, &readsMemory) || (readsMemory && !beforeExits(i))) continue;
+			for (j = 0; j < n && (ptr[j].array != q[i].x || ptr[j].iv != k); j++) ;
+			if (j == n) {
+				ptr[n].array	= q[i].x;
+				ptr[n].iv		= k;
+				ptr[n].p		= newUnitTemporary(func, getType(getSymbol(q[i].z)));
+				n++;
+			}
+			q[i].op	= O_ASSIGN;
+			q[i].x	= oS(ptr[j].p);
+			q[i].y	= o_;
+			#ifdef DEBUG
+			printf("opt: induction: quad %d uses pointer %s\n", i, entryName(ptr[j].p));
+			#endif
+		}
+	}
+	if (n > 0) {
+		pos = openPreheader(n);
+		for (j = 0; j < n; j++) {
+			q[pos + j].num	= pos + j;
+			q[pos + j].op	= O_ARRAY;
+			q[pos + j].x	= ptr[j].array;
+			q[pos + j].y	= oS(f->sym[ptr[j].iv]);
+			q[pos + j].z	= oS(ptr[j].p);
+		}
+		//the increments, from the last induction variable in q back, so that the others stay in place
+		for (last = g->last; ; last = defQuad[k]) {
+			for (k = -1, j = 0; j < n; j++)
+				if (defQuad[ptr[j].iv] < last && (k < 0 || defQuad[ptr[j].iv] > defQuad[k])) k = ptr[j].iv;
+			if (k < 0) break;
+			for (count = 0, j = 0; j < n; j++)
+				if (ptr[j].iv == k) count++;
+			i = defQuad[k] + n + 1;
+			insertQuads(i, count);
+			for (j = 0; j < n; j++) {
+				if (ptr[j].iv != k) continue;
+				q[i].num	= i;
+				q[i].op		= O_ADD;
+				q[i].x		= q[i].z = oS(ptr[j].p);
+				q[i].y		= oS(newConstant(NULL, typeInteger, (RepInteger) (short) (step[k] * sizeOfType(getType(ptr[j].p)->refType))));
+				i++;
+			}
+		}
+	}
+	delete(step);
+	delete(ptr);
+	return n > 0;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Interface -------------------------
+   ------------------------------------------------------------- */
+
+bool hoistInvariants(Cfg g)
+{
+	return everyLoop(g, hoistOut);
+}
+
+bool reduceInductions(Cfg g)
+{
+	return everyLoop(g, reduceStrength);
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ *
+ *  C header file : licm.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Loop invariant code motion and strength reduction
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __LICM_H__
+#define __LICM_H__
+
+#include <stdbool.h>
+
+#include "cfg.h"
+
+/* The natural loops of the unit are found from the back edges of its graph (an edge to a block
+ * that dominates its source). The quads of a loop that compute the same value on every iteration
+ * (arithmetic and array addresses on locals not written in the loop, calls of abs, ord, chr,
+ * strlen and strcmp on such arguments) move to a preheader, new quads before the header that
+ * only the entries of the loop reach. Inner loops first, one loop at a time, so what moves out
+ * of an inner loop may move out of the outer one next.
+ * The quads of the unit are renumbered (insertQuads) and g is left stale */
+bool	hoistInvariants	(Cfg g);
+
+/* In a loop where a local i changes only by a constant c (i := i + c, i := i - c), the address
+ * of a[i], for an array a that the loop does not assign, is kept in a new temporary that starts in
+ * the preheader and grows by c times the size of the elements whenever i changes. So every
+ * array quad on i becomes a copy and the multiplication of the index is gone */
+bool	reduceInductions	(Cfg g);
+
+#endif
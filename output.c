@@ -0,0 +1,138 @@
+/******************************************************************************
+ 
+ *  C code file   : output.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Buffered output of the .imm and .asm files
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   ---------------------- Global variables ---------------------
+   ------------------------------------------------------------- */
+
+#define OUT_BUF_SIZE 65536
+
+extern FILE *iout;
+extern FILE *fout;
+
+OutBuf immOut = NULL;
+OutBuf asmOut = NULL;
+
+
+/* -------------------------------------------------------------
+   ------------------------- Functions -------------------------
+   ------------------------------------------------------------- */
+
+void initOutput()
+{
+	immOut = newOutBuf(OUT_BUF_SIZE);
+	asmOut = newOutBuf(OUT_BUF_SIZE);
+}
+
+void flushOutput()
+{
+	if (iout != NULL) outFlush(immOut, iout);
+	if (fout != NULL) outFlush(asmOut, fout);
+}
+
+OutBuf newOutBuf(size_t size)
+{
+	OutBuf b = (OutBuf) new(sizeof(struct OutBuf_tag));
+	b->data = (char *) new(size);
+	b->len  = 0;
+	b->size = size;
+	return b;
+}
+
+//makes room for n more bytes
+static void outReserve(OutBuf b, size_t n)
+{
+	if (b->len + n <= b->size) return;
+	while (b->len + n > b->size) b->size *= 2;
+	b->data = (char *) realloc(b->data, b->size);
+	if (b->data == NULL) fatal("\rOut of memory");
+}
+
+void outChar(OutBuf b, char c)
+{
+	outReserve(b, 1);
+	b->data[b->len++] = c;
+}
+
+void outStr(OutBuf b, const char * s)
+{
+	size_t n = strlen(s);
+	outReserve(b, n);
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
+
+void outInt(OutBuf b, int n)
+{
+	char buf[12];		//12 = max letters of int
+	int i = 12;
+	unsigned int u = (n < 0) ? - (unsigned int) n : (unsigned int) n;
+	do {
+		buf[--i] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (n < 0) buf[--i] = '-';
+	outReserve(b, 12 - i);
+	memcpy(b->data + b->len, buf + i, 12 - i);
+	b->len += 12 - i;
+}
+
+void outVFmt(OutBuf b, const char * fmt, va_list ap)
+{
+	const char * p;
+	for (p = fmt; *p != '\0'; p++) {
+		if (*p != '%') { outChar(b, *p); continue; }
+		switch (*++p) {
+			case 's':	outStr(b, va_arg(ap, const char *));	break;
+			case 'd':	outInt(b, va_arg(ap, int));				break;
+			case 'c':	outChar(b, (char) va_arg(ap, int));		break;
+			case '%':	outChar(b, '%');						break;
+			default:	internal("outVFmt: unsupported format %%%c", *p);
+		}
+	}
+}
+
+void outFmt(OutBuf b, const char * fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	outVFmt(b, fmt, ap);
+	va_end(ap);
+}
+
+//writes the whole buffer with one write() (more only if the system writes it partially) and empties it
+void outFlush(OutBuf b, FILE * f)
+{
+	size_t done = 0;
+	fflush(f);		//anything already printed to f through stdio goes first
+	while (done < b->len) {
+		ssize_t n = write(fileno(f), b->data + done, b->len - done);
+		if (n < 0) fatal("output: write failed");
+		done += n;
+	}
+	b->len = 0;
+}
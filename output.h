@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ *  C header file : output.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Buffered output of the .imm and .asm files
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stdio.h>
+#include <stdarg.h>
+
+/* Output is appended in memory, in growable byte buffers, and written to its file 
+ * with a single write() when the buffer is flushed. Formatting is done by hand and
+ * supports only %s, %d, %c and %% */
+
+typedef struct OutBuf_tag * OutBuf;
+
+struct OutBuf_tag {
+	char *	data;
+	size_t	len;		//bytes used
+	size_t	size;		//bytes allocated
+};
+
+extern OutBuf	immOut;		//buffer of the .imm file (iout)
+extern OutBuf	asmOut;		//buffer of the .asm file (fout)
+
+void	initOutput	(void);
+void	flushOutput	(void);		/* writes immOut to iout and asmOut to fout */
+
+OutBuf	newOutBuf	(size_t size);
+void	outChar		(OutBuf b, char c);
+void	outStr		(OutBuf b, const char * s);
+void	outInt		(OutBuf b, int n);
+void	outFmt		(OutBuf b, const char * fmt, ...);
+void	outVFmt		(OutBuf b, const char * fmt, va_list ap);
+void	outFlush	(OutBuf b, FILE * f);
+
+#endif
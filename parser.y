@@ -30,6 +30,7 @@
 #include "general.h"
 #include "datastructs.h"
 #include "intermediate.h"
+#include "output.h"
 
 #define SYMBOLTABLE_SIZE 127
 
@@ -39,10 +40,14 @@
  */
 #ifndef INTERMEDIATE
 	#include "final.h"
+	#include "asm.h"
 #else
 	void printFinal() { fprintf(stderr, "Intermediate code only. Make-option used: INTERMEDIATE=1\n"); }
 	void skeletonBegin(Operand o, Queue q1, Queue q2) {;}
-	void skeletonEnd() {;}
+	void skeletonEnd(Queue q) {;}
+	bool asmComments;
+	bool displayMode;
+	bool disableRule(const char * name) { return false; }
 #endif
 
 
@@ -108,7 +113,7 @@ void printParQuads(callNode * n){
 	genNode * p = params->first;
 	while(p!=NULL) {
 		parNode * pn = p->data; 
-		printf("(%s,%s), ",pn->place->name,pn->passMode->name);
+		printf("(%s,%s), ",operandName(pn->place),pn->passMode->name);
 		fflush(stdout);
 		p=p->next;
 	}
@@ -131,7 +136,7 @@ static Queue	gcHungryFunc;	//Queue of Operands
 static Queue	gcHungryVar;	//Queue of SymbolEntries (that will be used as Queue of list of SymbolEntries)
 
 static Operand	firstBlock  = NULL;
-static bool		OFLAG		= false;
+static bool		SFLAG		= false;	//streaming mode: every unit is printed as soon as it is parsed
 
 
 /* -------------------------------------------------------------
@@ -160,9 +165,10 @@ typedef struct LibFunc_tag{
 void declareLF(LibFunc lf)
 {
 	//excessive check for internal consistency
-	if (lookupEntry(lf.name,LOOKUP_ALL_SCOPES,false)) 
+	const char * fname = intern(lf.name);
+	if (lookupEntry(fname,LOOKUP_ALL_SCOPES,false)) 
 		internal("LibFunc: run-time library function %s duplicate definition",lf.name);
-	SymbolEntry * func = newFunction(lf.name);
+	SymbolEntry * func = newFunction(fname);
 	forwardFunction(func);
 	openScope();
 	currentScope->returnType = lf.returnType;
@@ -172,9 +178,10 @@ void declareLF(LibFunc lf)
 		//excessive cheks for internal consistency
 		if (!p) 
 			internal("LibFunc: run-time library function %s expects more parameters", lf.name);
-		if(lookupEntry(p->name,LOOKUP_CURRENT_SCOPE, false)) 
+		const char * pname = intern(p->name);
+		if(lookupEntry(pname,LOOKUP_CURRENT_SCOPE, false)) 
 			internal("LibFunc: run-time library function %s has duplicate parameter %s", lf.name, p->name);
-		newParameter(p->name, p->type, p->passMode, func);
+		newParameter(pname, p->type, p->passMode, func);
 	}
 	endFunctionHeader(func, lf.returnType);
 	func->u.eFunction.gcHungry = lf.gcHungry;
@@ -226,6 +233,27 @@ void declareAllLibFunc()
 		declareLF(libraryFunctions[i]);
 }
 
+
+/* Streaming mode: called as soon as the O_ENDU quad of a unit has been generated.
+ * The unit is optimized and printed (intermediate and final code) and then its quads are
+ * recycled, so that memory needed is bounded by the largest unit and not by the whole program.
+ * Nested units always end before the quads of the enclosing unit start, so at this point 
+ * the quad array contains only the quads of the unit that has just ended.
+ */
+void emitUnit()
+{
+	static bool skeletonPrinted = false;
+	if(!skeletonPrinted) {
+		skeletonBegin(firstBlock, NULL, gcHungryVar);	//gc hungry functions are not all known yet
+		skeletonPrinted = true;
+	}
+	printQuads();
+	optimize();
+	printFinal();
+	recycleQuads();
+	flushOutput();		//one write() per unit and file
+}
+
 %}
 
 
@@ -330,10 +358,19 @@ void declareAllLibFunc()
 
 program		: { openScope(); declareAllLibFunc(); } 
 			  func_def 
-			  { printQuads(); 
-				if(OFLAG) optimize();
-				skeletonBegin(firstBlock, gcHungryFunc, gcHungryVar); printFinal(); skeletonEnd(); 
-				closeScope();}
+			  { if(!SFLAG) {
+					printQuads(); 
+					optimize();
+					skeletonBegin(firstBlock, gcHungryFunc, gcHungryVar); printFinal(); 
+				}
+				skeletonEnd(gcHungryFunc); 
+				flushOutput();
+				closeScope();
+				#ifdef DEBUG
+				arenaStats(globalArena);
+				arenaStats(unitArena);
+				#endif
+				}
 
 /* -------------------------------------------------------------------------------------------------------------------------------- 
  *	BLOCK DEFINITION (FUNCTIONS)
@@ -350,6 +387,7 @@ func_def	: "def"	{mem.forward=0;} header ':'	{if(firstBlock==NULL)
 												 genquad(O_ENDU,oU(s),o_,o_);
 												 
 												 s->u.eFunction.negOffset = currentScope->negOffset;
+												 s->u.eFunction.locals	  = currentScope->entries;
 												 #ifndef GC_FREE
 												 s->u.eFunction.gcHungry  = currentScope->gcHungry;
 												 if(currentScope->gcHungry) {
@@ -357,7 +395,7 @@ func_def	: "def"	{mem.forward=0;} header ':'	{if(firstBlock==NULL)
 													 addLastData(gcHungryVar,currentScope->entries); //add list of scope's variables
 													 #ifdef DEBUG
 													 printf("added gcHungry in gcHungryFunc: %s\n",s->id);
-													 printf("first entry in gcHungryVar: %s\n",currentScope->entries->id);
+													 printf("first entry in gcHungryVar: %s\n",entryName(currentScope->entries));
 													 #endif
 												 }
 												 #endif
@@ -365,7 +403,8 @@ func_def	: "def"	{mem.forward=0;} header ':'	{if(firstBlock==NULL)
 												 printf("scope %s closes\n",$3);
 												 #endif
 												 pop(funcStack);
-												 closeScope();} ;
+												 if(SFLAG)	{emitUnit();	releaseScope();}
+												 else		closeScope();} ;
 
 def_list	: func_def def_list 
 			| func_decl def_list	
@@ -894,13 +933,13 @@ rval:		  T_int_const		{$$.type=typeInteger;	$$.place = oS( newConstant(NULL,type
 											genquad(O_MULT,$4.place,s,w);
 											genquad(O_PAR,w,oV,o_);
 											genquad(O_PAR,z,oRET,o_);
-											genquad(O_CALL,o_,o_,oU(lookupEntry("newarrp",LOOKUP_ALL_SCOPES,false)));
+											genquad(O_CALL,o_,o_,oU(lookupEntry(intern("newarrp"),LOOKUP_ALL_SCOPES,false)));
 										 } else {
 											Operand s = oS(newConstant(NULL,typeInteger,sizeOfType($2)));	//size of referenced type in bytes
 											genquad(O_MULT,$4.place,s,w);
 											genquad(O_PAR,w,oV,o_);
 											genquad(O_PAR,z,oRET,o_);
-											genquad(O_CALL,o_,o_,oU(lookupEntry("newarrv",LOOKUP_ALL_SCOPES,false)));
+											genquad(O_CALL,o_,o_,oU(lookupEntry(intern("newarrv"),LOOKUP_ALL_SCOPES,false)));
 										 }
 										 $$.place=z;
 										 $$.cond=false;
@@ -917,9 +956,9 @@ rval:		  T_int_const		{$$.type=typeInteger;	$$.place = oS( newConstant(NULL,type
 										 Operand z = oS(newTemporary($$.type));
 										 SymbolEntry *func;
 										 if(equalType($1.type,typeIArray(typeAny)) || equalType($1.type,typeList(typeAny)))	
-											 func = lookupEntry("consp",LOOKUP_ALL_SCOPES,false);
+											 func = lookupEntry(intern("consp"),LOOKUP_ALL_SCOPES,false);
 										 else																					
-											 func = lookupEntry("consv",LOOKUP_ALL_SCOPES,false);
+											 func = lookupEntry(intern("consv"),LOOKUP_ALL_SCOPES,false);
 										 genquad(O_PAR,$1.place,oV,o_);
 										 genquad(O_PAR,$3.place,oV,o_);
 										 genquad(O_PAR,z,oRET,o_);
@@ -932,7 +971,7 @@ rval:		  T_int_const		{$$.type=typeInteger;	$$.place = oS( newConstant(NULL,type
 										 bool found = false;
 										 while(iterHasNext(i)){
 											 Operand f = iterNext(i);
-											 if(!strcmp(func->id,f->name)) {found=true; break;}
+											 if(func->id == f->name) {found=true; break;}	//both interned
 										 }
 										 if(!found)
 											addLastData(gcHungryFunc, oU(func)); //add consv or consp in the queue if they are not already there
@@ -953,7 +992,7 @@ rval:		  T_int_const		{$$.type=typeInteger;	$$.place = oS( newConstant(NULL,type
 			| "head" '(' expr ')'		{if(!equalType($3.type,typeList(typeAny))) 
 											sserror("expression in brackets must be some list type but is %s",typeToStr($3.type));
 										 $$.type=$3.type->refType;
-										 SymbolEntry *func = lookupEntry("head",LOOKUP_ALL_SCOPES,false);
+										 SymbolEntry *func = lookupEntry(intern("head"),LOOKUP_ALL_SCOPES,false);
 										 Operand z = oS(newTemporary($$.type));
 										 genquad(O_PAR,$3.place,oV,o_);
 										 genquad(O_PAR,z,oRET,o_);
@@ -967,7 +1006,7 @@ rval:		  T_int_const		{$$.type=typeInteger;	$$.place = oS( newConstant(NULL,type
 
 			| "tail" '(' expr ')'		{if(!equalType($3.type,typeList(typeAny))) sserror("expression in brackets must be some list type");
 										 $$.type=$3.type;
-										 SymbolEntry *func = lookupEntry("tail",LOOKUP_ALL_SCOPES,false);
+										 SymbolEntry *func = lookupEntry(intern("tail"),LOOKUP_ALL_SCOPES,false);
 										 Operand z = oS(newTemporary($$.type));
 										 genquad(O_PAR,$3.place,oV,o_);
 										 genquad(O_PAR,z,oRET,o_);
@@ -1027,7 +1066,18 @@ void parseArguments(int argc,char * argv[]){
 		else if (!strcmp(argv[i], "-i"))
 			IFLAG = true;
 		else if (!strcmp(argv[i], "-O"))
-			OFLAG = true;
+			setOptLevel(OPT_LEVEL_DEFAULT);
+		else if (argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '9' && argv[i][3] == '\0')
+			setOptLevel(argv[i][2] - '0');
+		else if (!strcmp(argv[i], "-fdisplay"))
+			displayMode = true;		//non-locals through a display
+		else if (!strncmp(argv[i], "-fno-", 5)) {
+			if (!disablePass(argv[i] + 5) && !disableRule(argv[i] + 5)) fatal("unknown optimization pass %s", argv[i] + 5);
+		}
+		else if (!strcmp(argv[i], "-s"))
+			SFLAG = true;
+		else if (!strcmp(argv[i], "-c"))
+			asmComments = false;	//compact assembly, without quad comments
 		else if (fileArg == 0)
 			fileArg = i;
 		else
@@ -1076,8 +1126,11 @@ void parseArguments(int argc,char * argv[]){
 void sigsegv_hndler(int signum)
 {
 	error("SIGSEV (Segmentation fault) caught. Printing and exiting...");
-	if (iout != NULL) {printQuads();	fflush(iout);	fclose(iout);}
-	if (fout != NULL) {printFinal();	fflush(fout);	fclose(fout);}
+	if (iout != NULL) printQuads();
+	if (fout != NULL) printFinal();
+	flushOutput();
+	if (iout != NULL) fclose(iout);
+	if (fout != NULL) fclose(fout);
 	fatal("SIGSEV: exited");
 }
 #endif
@@ -1090,6 +1143,7 @@ int main(int argc, char * argv[])
 	ifStack   = newStack(sizeof(ifNode));
 	funcStack = newStack(sizeof(funcStack));
 	initIntermediate();
+	initOutput();
 	#ifndef INTERMEDIATE
 	initFinal();
 	#endif
@@ -1107,6 +1161,7 @@ int main(int argc, char * argv[])
 	parseArguments(argc, argv);
 
 	/* Initializing Symbol Table  */
+	initArenas();
 	initSymbolTable(SYMBOLTABLE_SIZE);
 
 	/* Calling the syntax parser */
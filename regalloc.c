@@ -0,0 +1,172 @@
+/******************************************************************************
+
+ *  C code file   : regalloc.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Allocation of registers to the temporaries of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "regalloc.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+const char * registerName[REG_NUM] = { "bx", "cx", "dx", "si", "di" };
+
+#define REG_BIT(R)	(1U << (R))
+#define REG_ALL		(REG_BIT(REG_NUM) - 1)
+
+//the one that needs the fewest quads to keep away from first: bx is scratch of none
+static const Register preference[REG_NUM] = { REG_BX, REG_SI, REG_DI, REG_CX, REG_DX };
+
+/* The registers that the final code of a quad writes, besides its result (final.c).
+ * A non-local goes through si (getAR), so do the parameters by reference and $$, [x] through di */
+static unsigned symbolClobbers(SymbolEntry * s, unsigned int level)
+{
+	if (s == NULL || s->entryType == ENTRY_CONSTANT || s->entryType == ENTRY_FUNCTION) return 0;
+	if (s->nestingLevel < level) return REG_BIT(REG_SI);
+	if (s->entryType == ENTRY_PARAMETER && s->u.eParameter.mode == PASS_BY_REFERENCE) return REG_BIT(REG_SI);
+	return 0;
+}
+
+static unsigned operandClobbers(Operand o, unsigned int level)
+{
+	switch (o->type) {
+		case OPERAND_SYMBOL:
+		case OPERAND_ADDRESS:		return symbolClobbers(getSymbol(o), level);
+		case OPERAND_DEREFERENCE:	return REG_BIT(REG_DI) | symbolClobbers(getSymbol(o), level);
+		case OPERAND_RESULT:		return REG_BIT(REG_SI);
+		default:					return 0;
+	}
+}
+
+static unsigned quadClobbers(int i, unsigned int level)
+{
+	unsigned c = operandClobbers(q[i].x, level) | operandClobbers(q[i].y, level) | operandClobbers(q[i].z, level);
+	switch (q[i].op) {
+		case O_ARRAY: case O_MULT: case O_DIV: case O_MOD:
+			return c | REG_BIT(REG_CX) | REG_BIT(REG_DX);	//imul, idiv: dx:ax
+		case O_ADD: case O_SUB:
+		case O_EQ: case O_NE: case O_LT: case O_GT: case O_LE: case O_GE:
+			return c | REG_BIT(REG_DX);
+		case O_PAR:
+			if (q[i].y != oV || sizeOfType(getType(getSymbol(q[i].x))) == 1) c |= REG_BIT(REG_SI);
+			return c;
+		case O_CALL:
+			return REG_ALL;
+		default:
+			return c;
+	}
+}
+
+//[t] is loaded through di: a t that is the only pointer followed by q[i] may be kept in di itself
+static unsigned clobbersFor(Flow f, int i, int k, unsigned c)
+{
+	bool other = false, own = false;
+	Operand o[3] = { q[i].x, q[i].y, q[i].z };
+	int j;
+	for (j = 0; j < 3; j++)
+		if (o[j]->type == OPERAND_DEREFERENCE) {
+			if (flowIndex(f, o[j]) == k)	own = true;
+			else							other = true;
+		}
+	return (own && !other) ? c & ~REG_BIT(REG_DI) : c;
+}
+
+static bool candidate(SymbolEntry * s, bool gcHungry)
+{
+	Type t = getType(s);
+	if (s->entryType != ENTRY_TEMPORARY || sizeOfType(t) != 2) return false;
+	return !(gcHungry && equalType(t, typeList(typeAny)));	//roots of the call tables
+}
+
+bool allocateRegisters(Cfg g)
+{
+	SymbolEntry * func = getSymbol(q[g->first].x);
+	bool gcHungry = func->u.eFunction.gcHungry;
+	Flow f;
+	Set * conflict;
+	Set live;
+	unsigned * forbidden;
+	bool * allowed;
+	int b, i, k, j, d, r, count = 0;
+
+	f = newFlow(g);
+	computeLiveness(f);
+	conflict	= (Set *) new((f->symNum + 1) * sizeof(Set));
+	forbidden	= (unsigned *) new((f->symNum + 1) * sizeof(unsigned));
+	allowed		= (bool *) new((f->symNum + 1) * sizeof(bool));
+	live		= newSet(f);
+	for (k = 0; k < f->symNum; k++) {
+		conflict[k]		= newSet(f);
+		forbidden[k]	= 0;
+		allowed[k]		= candidate(f->sym[k], gcHungry);
+	}
+
+	/* Backwards over every block: what is live after q[i] or read by it must survive its scratch
+	 * registers, its result must not overwrite what is live after it */
+	for (b = 0; b < g->blockNum; b++) {
+		if (!g->block[b].reachable) continue;
+		setCopy(f, live, f->liveOut[b]);
+		for (i = g->block[b].last; i >= g->block[b].first; i--) {
+			if (!ISACTIVE(q[i].num)) continue;
+			unsigned c = quadClobbers(i, f->level);
+			d = quadDef(f, i);
+			if (q[i].op == O_PAR && q[i].y != oV && (k = flowIndex(f, q[i].x)) >= 0) allowed[k] = false;
+			if (q[i].x->type == OPERAND_ADDRESS && (k = flowIndex(f, q[i].x)) >= 0) allowed[k] = false;
+			if (q[i].y->type == OPERAND_ADDRESS && (k = flowIndex(f, q[i].y)) >= 0) allowed[k] = false;
+			for (k = 0; k < f->symNum; k++) {
+				if (!SET_HAS(live, k) || k == d) continue;
+				forbidden[k] |= clobbersFor(f, i, k, c);
+				if (d >= 0) {
+					SET_ADD(conflict[d], k);
+					SET_ADD(conflict[k], d);
+				}
+			}
+			liveStep(f, i, live);
+			//the operands read, now in live
+			if ((k = flowIndex(f, q[i].x)) >= 0) forbidden[k] |= clobbersFor(f, i, k, c);
+			if ((k = flowIndex(f, q[i].y)) >= 0) forbidden[k] |= clobbersFor(f, i, k, c);
+			if (q[i].z->type == OPERAND_DEREFERENCE && (k = flowIndex(f, q[i].z)) >= 0) forbidden[k] |= clobbersFor(f, i, k, c);
+		}
+	}
+
+	//greedy, in the order of the first appearance in the unit
+	for (k = 0; k < f->symNum; k++) {
+		if (!allowed[k]) continue;
+		unsigned taken = forbidden[k];
+		for (j = 0; j < f->symNum; j++)
+			if (allowed[j] && j != k && SET_HAS(conflict[k], j) && f->sym[j]->u.eTemporary.reg >= 0)
+				taken |= REG_BIT(f->sym[j]->u.eTemporary.reg);
+		for (r = 0; r < REG_NUM && (taken & REG_BIT(preference[r])); r++) ;
+		if (r == REG_NUM) continue;
+		f->sym[k]->u.eTemporary.reg = preference[r];
+		count++;
+	}
+	#ifdef DEBUG
+	printf("regalloc: %s: %d temporaries in registers\n", func->id, count);
+	#endif
+
+	for (k = 0; k < f->symNum; k++) delete(conflict[k]);
+	delete(conflict);
+	delete(forbidden);
+	delete(allowed);
+	delete(live);
+	deleteFlow(f);
+	return count > 0;
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ *
+ *  C header file : regalloc.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Allocation of registers to the temporaries of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __REGALLOC_H__
+#define __REGALLOC_H__
+
+#include <stdbool.h>
+
+#include "cfg.h"
+
+/* The registers that final.c leaves free between quads: ax is the accumulator of every quad */
+typedef enum {
+	REG_BX,
+	REG_CX,
+	REG_DX,
+	REG_SI,
+	REG_DI,
+	REG_NUM
+} Register;
+
+extern const char * registerName[REG_NUM];
+
+/* A word temporary of the unit gets a register (eTemporary.reg) that no quad uses as scratch
+ * while the temporary is live (the final code of every quad is known here, see quadClobbers()
+ * in regalloc.c) and that no other temporary live at its definition holds. The rest stay in
+ * their slots: bytes, lists of functions that call the garbage collector, temporaries whose
+ * address is taken (par x, R and par x, RET) and those live across a call.
+ * Must run after the passes that change the quads and before the slots are shared */
+bool	allocateRegisters	(Cfg g);
+
+#endif
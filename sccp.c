@@ -0,0 +1,350 @@
+/******************************************************************************
+
+ *  C code file   : sccp.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Sparse conditional constant propagation
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sccp.h"
+#include "ssa.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   -------------------------- Lattice --------------------------
+   ------------------------------------------------------------- */
+
+typedef enum {
+	L_TOP,			//not evaluated yet
+	L_CONST,		//always the same constant
+	L_BOTTOM		//anything
+} Level;
+
+typedef struct {
+	Level			level;
+	SymbolEntry *	c;		//L_CONST: the (pooled) constant
+} Lattice;
+
+static Ssa			s;
+static Lattice *	lat;		//per value
+static bool *		blockExec;
+static bool *		edgeExec;	//edgeExec[2*b + t]: the edge to block[b].succ[t] may be taken
+static int *		work;		//values whose lattice was lowered
+static int			workNum;
+static bool *		inWork;
+
+static const Lattice bottom = { L_BOTTOM, NULL };
+static const Lattice top	= { L_TOP, NULL };
+
+//only constants that fit in a register are propagated
+static bool isScalar(SymbolEntry * c)
+{
+	Type t = getType(c);
+	return t->kind == TYPE_INTEGER || t->kind == TYPE_BOOLEAN || t->kind == TYPE_CHAR;
+}
+
+//the value the 8086 sees: 16-bit integers, signed chars
+static int valueOf(SymbolEntry * c)
+{
+	switch (getType(c)->kind) {
+		case TYPE_INTEGER:	return (short) c->u.eConstant.value.vInteger;
+		case TYPE_BOOLEAN:	return c->u.eConstant.value.vBoolean;
+		case TYPE_CHAR:		return (signed char) c->u.eConstant.value.vChar;
+		default:			internal("sccp: not a scalar constant");
+	}
+	return 0;
+}
+
+static Lattice constant(SymbolEntry * c)
+{
+	Lattice l = { L_CONST, c };
+	return l;
+}
+
+static Lattice meet(Lattice a, Lattice b)
+{
+	if (a.level == L_TOP) return b;
+	if (b.level == L_TOP) return a;
+	if (a.level == L_CONST && b.level == L_CONST && a.c == b.c) return a;	//constants are pooled
+	return bottom;
+}
+
+static void lower(int v, Lattice l)
+{
+	if (v <= SSA_UNKNOWN) return;
+	l = meet(lat[v], l);
+	if (l.level == lat[v].level && l.c == lat[v].c) return;
+	lat[v] = l;
+	if (!inWork[v]) {
+		inWork[v] = true;
+		work[workNum++] = v;
+	}
+}
+
+//operand o read by a quad as value u (SSA_USEX/Y)
+static Lattice operandValue(Operand o, int u)
+{
+	if (o->type != OPERAND_SYMBOL) return bottom;	//[x], $$
+	SymbolEntry * e = getSymbol(o);
+	if (e->entryType == ENTRY_CONSTANT) return isScalar(e) ? constant(e) : bottom;
+	if (u < 0) return bottom;	//not a local
+	return lat[u];
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Evaluation ------------------------
+   ------------------------------------------------------------- */
+
+static Lattice fold(OperatorType op, Lattice a, Lattice b)
+{
+	int v1, v2, res;
+	if (a.level == L_BOTTOM || b.level == L_BOTTOM) return bottom;
+	if (a.level == L_TOP || b.level == L_TOP) return top;
+	v1 = valueOf(a.c);
+	v2 = valueOf(b.c);
+	switch (op) {
+		case O_ADD:		res = v1 + v2;	break;
+		case O_SUB:		res = v1 - v2;	break;
+		case O_MULT:	res = v1 * v2;	break;
+		case O_DIV:
+		case O_MOD:
+			if (v2 == 0 || (v1 == -32768 && v2 == -1)) return bottom;	//left to fail at run time
+			res = (op == O_DIV) ? v1 / v2 : v1 % v2;	//truncated, as idiv
+			break;
+		default:		return bottom;
+	}
+	return constant(newConstant(NULL, typeInteger, (RepInteger) (short) res));
+}
+
+//condition of a branch: TOP, or a boolean constant, or BOTTOM
+static Lattice condition(int i)
+{
+	Lattice a = operandValue(q[i].x, SSA_USEX(s, i));
+	Lattice b = operandValue(q[i].y, SSA_USEY(s, i));
+	bool taken;
+	int v1, v2;
+	if (q[i].op == O_IFB) b = constant(newConstant(NULL, typeBoolean, false));
+	if (a.level == L_BOTTOM || b.level == L_BOTTOM) return bottom;
+	if (a.level == L_TOP || b.level == L_TOP) return top;
+	v1 = valueOf(a.c);
+	v2 = valueOf(b.c);
+	switch (q[i].op) {
+		case O_EQ:	taken = v1 == v2;	break;
+		case O_NE:
+		case O_IFB:	taken = v1 != v2;	break;
+		case O_LT:	taken = v1 <  v2;	break;
+		case O_GT:	taken = v1 >  v2;	break;
+		case O_LE:	taken = v1 <= v2;	break;
+		case O_GE:	taken = v1 >= v2;	break;
+		default:	internal("sccp: not a branch");
+	}
+	return constant(newConstant(NULL, typeBoolean, taken));
+}
+
+static void markEdge(int b, int t);
+
+static void visitPhi(int p)
+{
+	Phi * phi = &(s->phi[p]);
+	Block * blk = &(s->g->block[phi->block]);
+	Lattice l = top;
+	int j, t;
+	for (j = 0; j < blk->predNum; j++) {
+		int pb = blk->pred[j];
+		for (t = 0; t < 2; t++)
+			if (s->g->block[pb].succ[t] == phi->block && edgeExec[2*pb + t]) break;
+		if (t == 2) continue;
+		l = meet(l, (phi->arg[j] == SSA_UNKNOWN) ? bottom : lat[phi->arg[j]]);
+	}
+	lower(phi->value, l);
+}
+
+static void visitQuad(int i)
+{
+	Cfg g = s->g;
+	int b = BLOCK_OF(g, i);
+	int d = SSA_DEF(s, i);
+	OperatorType op = q[i].op;
+	if (d >= 0) {
+		if (op == O_ASSIGN)
+			lower(d, operandValue(q[i].x, SSA_USEX(s, i)));
+		else if (op == O_ADD || op == O_SUB || op == O_MULT || op == O_DIV || op == O_MOD)
+			lower(d, fold(op, operandValue(q[i].x, SSA_USEX(s, i)), operandValue(q[i].y, SSA_USEY(s, i))));
+		else
+			lower(d, bottom);	//O_ARRAY, par x,RET
+	}
+	if (ISBRANCH(op) && i == lastActive(&(g->block[b]))) {
+		Lattice c = condition(i);
+		int taken = (g->block[b].succ[1] >= 0) ? 1 : 0;
+		if (c.level == L_BOTTOM) {
+			markEdge(b, 0);
+			markEdge(b, taken);
+		}
+		else if (c.level == L_CONST)
+			markEdge(b, c.c->u.eConstant.value.vBoolean ? taken : 0);
+	}
+}
+
+static void visitBlock(int b)
+{
+	Block * blk = &(s->g->block[b]);
+	int i, p, last = lastActive(blk);
+	for (p = s->phiFirst[b]; p < s->phiFirst[b + 1]; p++) visitPhi(p);
+	for (i = blk->first; i <= blk->last; i++)
+		if (ISACTIVE(q[i].num)) visitQuad(i);
+	if (last < 0 || !ISBRANCH(q[last].op)) {
+		if (blk->succ[0] >= 0) markEdge(b, 0);
+		if (blk->succ[1] >= 0) markEdge(b, 1);
+	}
+}
+
+//the first time a block is reached all of it is evaluated, later only its phis (new incoming edge)
+static void markEdge(int b, int t)
+{
+	int d = s->g->block[b].succ[t], p;
+	if (d < 0 || edgeExec[2*b + t]) return;
+	edgeExec[2*b + t] = true;
+	if (!blockExec[d]) {
+		blockExec[d] = true;
+		visitBlock(d);
+	}
+	else
+		for (p = s->phiFirst[d]; p < s->phiFirst[d + 1]; p++) visitPhi(p);
+}
+
+static void propagate()
+{
+	int k, u;
+	while (workNum > 0) {
+		int v = work[--workNum];
+		inWork[v] = false;
+		for (k = s->userFirst[v]; k < s->userFirst[v + 1]; k++) {
+			u = s->user[k];
+			if (u < 0) {
+				if (blockExec[s->phi[-u - 1].block]) visitPhi(-u - 1);
+			}
+			else if (blockExec[BLOCK_OF(s->g, u + s->g->first)])
+				visitQuad(u + s->g->first);
+		}
+	}
+}
+
+
+/* -------------------------------------------------------------
+   -------------------------- Rewrite --------------------------
+   ------------------------------------------------------------- */
+
+static bool replaceUse(Operand * o, int u)
+{
+	if ((*o)->type != OPERAND_SYMBOL || u <= SSA_UNKNOWN || lat[u].level != L_CONST) return false;
+	*o = oS(lat[u].c);
+	return true;
+}
+
+static bool rewrite()
+{
+	Cfg g = s->g;
+	bool changed = false;
+	int b, i;
+	for (b = 0; b < g->blockNum; b++) {
+		Block * blk = &(g->block[b]);
+		for (i = blk->first; i <= blk->last; i++) {
+			if (!ISACTIVE(q[i].num) || q[i].op == O_UNIT || q[i].op == O_ENDU) continue;
+			if (!blockExec[b]) {
+				q[i].num = -1;
+				changed = true;
+				#ifdef DEBUG
+				printf("opt: sccp: quad %d never reached, removed\n", i);
+				#endif
+				continue;
+			}
+			OperatorType op = q[i].op;
+			int d = SSA_DEF(s, i);
+			if (d >= 0 && lat[d].level == L_CONST && op != O_PAR && !(op == O_ASSIGN && q[i].x == oS(lat[d].c))) {
+				q[i].op	= O_ASSIGN;
+				q[i].x	= oS(lat[d].c);
+				q[i].y	= o_;
+				changed = true;
+				#ifdef DEBUG
+				printf("opt: sccp: quad %d is constant\n", i);
+				#endif
+				continue;
+			}
+			if (ISBRANCH(op)) {
+				Lattice c = condition(i);
+				if (c.level == L_CONST) {
+					if (c.c->u.eConstant.value.vBoolean) {
+						q[i].op	= O_JUMP;
+						q[i].x	= q[i].y = o_;
+					}
+					else
+						q[i].num = -1;
+					changed = true;
+					#ifdef DEBUG
+					printf("opt: sccp: branch %d decided\n", i);
+					#endif
+					continue;
+				}
+			}
+			if (op == O_PAR && q[i].y != oV) continue;	//by reference: the address of x
+			changed |= replaceUse(&(q[i].x), SSA_USEX(s, i));
+			changed |= replaceUse(&(q[i].y), SSA_USEY(s, i));
+		}
+	}
+	return changed;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Interface -------------------------
+   ------------------------------------------------------------- */
+
+bool sccp(Cfg g)
+{
+	int v;
+	bool changed;
+	s = buildSsa(g);
+	lat			= (Lattice *) new((s->valueNum + 1) * sizeof(Lattice));
+	work		= (int *) new((s->valueNum + 1) * sizeof(int));
+	inWork		= (bool *) new((s->valueNum + 1) * sizeof(bool));
+	blockExec	= (bool *) new(g->blockNum * sizeof(bool));
+	edgeExec	= (bool *) new(2 * g->blockNum * sizeof(bool));
+	for (v = 0; v < s->valueNum; v++) {
+		lat[v] = top;
+		inWork[v] = false;
+	}
+	lat[SSA_UNKNOWN] = bottom;
+	for (v = 0; v < g->blockNum; v++) blockExec[v] = edgeExec[2*v] = edgeExec[2*v + 1] = false;
+	workNum = 0;
+
+	blockExec[0] = true;
+	visitBlock(0);
+	propagate();
+	changed = rewrite();
+
+	delete(lat);
+	delete(work);
+	delete(inWork);
+	delete(blockExec);
+	delete(edgeExec);
+	deleteSsa(s);
+	return changed;
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+ *
+ *  C header file : sccp.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Sparse conditional constant propagation
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __SCCP_H__
+#define __SCCP_H__
+
+#include <stdbool.h>
+
+#include "cfg.h"
+
+/* Wegman - Zadeck over the SSA form of the unit (ssa.h): the values of the locals that are
+ * constants (integer, boolean, char) are found, following only the edges of the flow that may
+ * be taken. Their reads are replaced by the constants, the branches whose condition is known
+ * become O_JUMP or are removed, and so are the quads of the blocks never reached.
+ * Returns whether some quad changed (the blocks of g are then stale) */
+bool	sccp	(Cfg g);
+
+#endif
@@ -0,0 +1,134 @@
+/******************************************************************************
+
+ *  C code file   : slots.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Sharing of stack slots among the temporaries of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "slots.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* Temporaries by the slots they may share */
+typedef enum {
+	SLOT_BYTE,		//bool, char
+	SLOT_WORD,		//int, arrays, lists of functions that do not call the garbage collector
+	SLOT_ROOT		//lists of functions that call it: a slot each
+} SlotClass;
+
+static SlotClass classOf(SymbolEntry * s, bool gcHungry)
+{
+	Type t = getType(s);
+	if (gcHungry && equalType(t, typeList(typeAny))) return SLOT_ROOT;
+	return (sizeOfType(t) == 1) ? SLOT_BYTE : SLOT_WORD;
+}
+
+//temporaries that are written while another is live (a write to the slot would destroy it)
+static Set * interference(Flow f)
+{
+	Cfg g = f->g;
+	Set * conflict = (Set *) new((f->symNum + 1) * sizeof(Set));
+	Set live = newSet(f);
+	int b, i, d, k;
+	for (k = 0; k < f->symNum; k++) conflict[k] = newSet(f);
+	for (b = 0; b < g->blockNum; b++) {
+		if (!g->block[b].reachable) continue;
+		setCopy(f, live, f->liveOut[b]);
+		for (i = g->block[b].last; i >= g->block[b].first; i--) {
+			if (!ISACTIVE(q[i].num)) continue;
+			//par x, RET: the callee writes x at the call, the values live then are live here too
+			if ((d = quadDef(f, i)) >= 0 && f->sym[d]->entryType == ENTRY_TEMPORARY)
+				for (k = 0; k < f->symNum; k++)
+					if (k != d && SET_HAS(live, k) && f->sym[k]->entryType == ENTRY_TEMPORARY) {
+						SET_ADD(conflict[d], k);
+						SET_ADD(conflict[k], d);
+					}
+			liveStep(f, i, live);
+		}
+	}
+	delete(live);
+	return conflict;
+}
+
+bool shareSlots(Cfg g)
+{
+	SymbolEntry * func = getSymbol(q[g->first].x);
+	bool gcHungry = func->u.eFunction.gcHungry;
+	SymbolEntry * e;
+	Flow f;
+	Set * conflict;
+	int * color;
+	bool * used;
+	int colors[SLOT_ROOT + 1] = { 0, 0, 0 };
+	int top, oldSize, k, j, c, roots;
+
+	//the temporaries are below the variables, from top down to negOffset
+	top = func->u.eFunction.negOffset;
+	for (e = func->u.eFunction.locals; e != NULL; e = e->nextInScope)
+		if (e->entryType == ENTRY_TEMPORARY && e->u.eTemporary.offset + (int) sizeOfType(getType(e)) > top)
+			top = e->u.eTemporary.offset + (int) sizeOfType(getType(e));
+	for (e = func->u.eFunction.locals; e != NULL; e = e->nextInScope)
+		if (e->entryType == ENTRY_VARIABLE && e->u.eVariable.offset < top) return false;
+	oldSize = top - func->u.eFunction.negOffset;
+	if (oldSize == 0) return false;
+
+	f = newFlow(g);
+	computeLiveness(f);
+	conflict = interference(f);
+	color	= (int *) new((f->symNum + 1) * sizeof(int));
+	used	= (bool *) new((f->symNum + 1) * sizeof(bool));
+	for (k = 0; k < f->symNum; k++) {
+		color[k] = -1;
+		if (f->sym[k]->entryType != ENTRY_TEMPORARY) continue;
+		if (f->sym[k]->u.eTemporary.reg >= 0) continue;	//in a register (regalloc.c): no slot
+		SlotClass sc = classOf(f->sym[k], gcHungry);
+		if (sc == SLOT_ROOT) continue;
+		for (c = 0; c < colors[sc]; c++) used[c] = false;
+		for (j = 0; j < k; j++)
+			if (color[j] >= 0 && SET_HAS(conflict[k], j) && classOf(f->sym[j], gcHungry) == sc) used[color[j]] = true;
+		for (c = 0; c < colors[sc] && used[c]; c++) ;
+		color[k] = c;
+		if (c == colors[sc]) colors[sc]++;
+	}
+
+	//roots first (every one, even if no quad uses it any more), then words, then bytes
+	roots = 0;
+	for (e = func->u.eFunction.locals; e != NULL; e = e->nextInScope)
+		if (e->entryType == ENTRY_TEMPORARY && classOf(e, gcHungry) == SLOT_ROOT)
+			e->u.eTemporary.offset = top - 2 * (++roots);
+	for (k = 0; k < f->symNum; k++) {
+		if (color[k] < 0) continue;
+		if (classOf(f->sym[k], gcHungry) == SLOT_WORD)
+			f->sym[k]->u.eTemporary.offset = top - 2 * roots - 2 * (color[k] + 1);
+		else
+			f->sym[k]->u.eTemporary.offset = top - 2 * roots - 2 * colors[SLOT_WORD] - (color[k] + 1);
+	}
+	func->u.eFunction.negOffset = top - 2 * roots - 2 * colors[SLOT_WORD] - colors[SLOT_BYTE];
+	#ifdef DEBUG
+	printf("slots: %s: temporaries in %d bytes instead of %d\n", func->id, top - func->u.eFunction.negOffset, oldSize);
+	#endif
+
+	for (k = 0; k < f->symNum; k++) delete(conflict[k]);
+	delete(conflict);
+	delete(color);
+	delete(used);
+	deleteFlow(f);
+	return top - func->u.eFunction.negOffset < oldSize;
+}
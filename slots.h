@@ -0,0 +1,35 @@
+/******************************************************************************
+ *
+ *  C header file : slots.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Sharing of stack slots among the temporaries of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __SLOTS_H__
+#define __SLOTS_H__
+
+#include <stdbool.h>
+
+#include "cfg.h"
+
+/* newTemporary() gives every temporary its own slot, below the variables of the unit.
+ * Here two temporaries of the same size that are never live at the same time (interference
+ * from the liveness of dataflow.h) get the same slot, by greedy coloring, and the slots are
+ * laid out again from the variables down: eTemporary.offset and eFunction.negOffset change.
+ * Lists of a function that calls the garbage collector keep a slot of their own each, as its
+ * call tables list every one of them as a root, live or not. Temporaries that are kept in a
+ * register (eTemporary.reg) get no slot at all.
+ * Must run after the passes that change the quads and the registers. Returns whether the frame got smaller */
+bool	shareSlots	(Cfg g);
+
+#endif
@@ -0,0 +1,375 @@
+/******************************************************************************
+
+ *  C code file   : ssa.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Static single assignment form of the quads of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "ssa.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   ------------------------ Int lists --------------------------
+   ------------------------------------------------------------- */
+
+typedef struct {
+	int *	a;
+	int		n;
+	int		size;
+} IntList;
+
+static void add(IntList * l, int x)
+{
+	if (l->n == l->size) {
+		l->size = (l->size == 0) ? 4 : 2 * l->size;
+		l->a = (int *) realloc(l->a, l->size * sizeof(int));
+		if (l->a == NULL) fatal("Out of memory");
+	}
+	l->a[l->n++] = x;
+}
+
+static IntList * newLists(int n)
+{
+	int i;
+	IntList * l = (IntList *) new(n * sizeof(IntList));
+	for (i = 0; i < n; i++) {
+		l[i].a = NULL;
+		l[i].n = l[i].size = 0;
+	}
+	return l;
+}
+
+static void deleteLists(IntList * l, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) delete(l[i].a);
+	delete(l);
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------ Definitions ------------------------
+   ------------------------------------------------------------- */
+
+//a function declared in the unit may write its variables
+static bool writesVariables(Flow f, int i)
+{
+	return q[i].op == O_CALL && getSymbol(q[i].z)->nestingLevel >= f->level;
+}
+
+//local given by reference to the call that follows
+static int refArgument(Flow f, int i)
+{
+	if (q[i].op != O_PAR || q[i].y != oR || q[i].x->type != OPERAND_SYMBOL) return -1;
+	return flowIndex(f, q[i].x);
+}
+
+//the blocks where each local is defined
+static IntList * defBlocks(Ssa s)
+{
+	Cfg g = s->g;
+	Flow f = s->f;
+	IntList * defs = newLists(f->symNum);
+	int b, i, k, d;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!g->block[b].reachable) continue;
+		for (i = g->block[b].first; i <= g->block[b].last; i++) {
+			if (!ISACTIVE(q[i].num)) continue;
+			if ((d = quadDef(f, i)) >= 0 || (d = refArgument(f, i)) >= 0) {
+				if (defs[d].n == 0 || defs[d].a[defs[d].n - 1] != b) add(&(defs[d]), b);
+			}
+			else if (writesVariables(f, i))
+				for (k = 0; k < f->symNum; k++)
+					if (SET_HAS(f->vars, k) && (defs[k].n == 0 || defs[k].a[defs[k].n - 1] != b)) add(&(defs[k]), b);
+		}
+	}
+	return defs;
+}
+
+//Cytron et al.: b is in the frontier of every block from a predecessor of b up to the dominator of b
+static IntList * frontiers(Cfg g)
+{
+	IntList * df = newLists(g->blockNum);
+	int b, j, r;
+	for (b = 0; b < g->blockNum; b++) {
+		Block * p = &(g->block[b]);
+		if (!p->reachable || p->predNum < 2) continue;
+		for (j = 0; j < p->predNum; j++)
+			for (r = p->pred[j]; r >= 0 && r != p->idom; r = g->block[r].idom)
+				if (df[r].n == 0 || df[r].a[df[r].n - 1] != b) add(&(df[r]), b);
+	}
+	return df;
+}
+
+//a local gets a phi in the iterated frontier of its definitions, if it is live there
+static void placePhis(Ssa s)
+{
+	Cfg g = s->g;
+	Flow f = s->f;
+	IntList * defs = defBlocks(s);
+	IntList * df = frontiers(g);
+	IntList * phis = newLists(g->blockNum);
+	IntList work = { NULL, 0, 0 };
+	int * hasPhi = (int *) new(g->blockNum * sizeof(int));
+	int * queued = (int *) new(g->blockNum * sizeof(int));
+	int b, k, i, j, d;
+	for (b = 0; b < g->blockNum; b++) hasPhi[b] = queued[b] = -1;
+	s->phiNum = 0;
+	for (k = 0; k < f->symNum; k++) {
+		work.n = 0;
+		for (i = 0; i < defs[k].n; i++) {
+			add(&work, defs[k].a[i]);
+			queued[defs[k].a[i]] = k;
+		}
+		while (work.n > 0) {
+			b = work.a[--work.n];
+			for (j = 0; j < df[b].n; j++) {
+				d = df[b].a[j];
+				if (hasPhi[d] == k || !SET_HAS(f->liveIn[d], k)) continue;
+				hasPhi[d] = k;
+				add(&(phis[d]), k);
+				s->phiNum++;
+				if (queued[d] != k) {
+					queued[d] = k;
+					add(&work, d);
+				}
+			}
+		}
+	}
+	//all phis in one array, by block
+	s->phi		= (Phi *) new((s->phiNum + 1) * sizeof(Phi));
+	s->phiFirst	= (int *) new((g->blockNum + 1) * sizeof(int));
+	i = 0;
+	for (b = 0; b < g->blockNum; b++) {
+		s->phiFirst[b] = i;
+		for (j = 0; j < phis[b].n; j++, i++) {
+			int a;
+			s->phi[i].block	= b;
+			s->phi[i].sym	= phis[b].a[j];
+			s->phi[i].value	= -1;
+			s->phi[i].arg	= (int *) new((g->block[b].predNum + 1) * sizeof(int));
+			for (a = 0; a < g->block[b].predNum; a++) s->phi[i].arg[a] = SSA_UNKNOWN;
+		}
+	}
+	s->phiFirst[g->blockNum] = i;
+	delete(work.a);
+	delete(hasPhi);
+	delete(queued);
+	deleteLists(defs, f->symNum);
+	deleteLists(df, g->blockNum);
+	deleteLists(phis, g->blockNum);
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Renaming --------------------------
+   ------------------------------------------------------------- */
+
+/* The value of every local at the current point of the walk of the dominator tree is in cur.
+ * Every change is logged with the previous value, to be undone when the walk leaves the block */
+static int *	cur;
+static int *	logSym;
+static int *	logValue;
+static int		logTop;
+static int		logSize;
+
+static void setCur(int k, int v)
+{
+	if (logTop == logSize) {
+		logSize *= 2;
+		logSym   = (int *) realloc(logSym, logSize * sizeof(int));
+		logValue = (int *) realloc(logValue, logSize * sizeof(int));
+		if (logSym == NULL || logValue == NULL) fatal("Out of memory");
+	}
+	logSym[logTop]		= k;
+	logValue[logTop++]	= cur[k];
+	cur[k] = v;
+}
+
+static int newValue(Ssa s, int k, int def)
+{
+	s->valueSym[s->valueNum] = k;
+	s->valueDef[s->valueNum] = def;
+	return s->valueNum++;
+}
+
+static int useOf(Ssa s, Operand o)
+{
+	int k = flowIndex(s->f, o);
+	return (k >= 0) ? cur[k] : -1;
+}
+
+static void renameBlock(Ssa s, IntList * children, int b)
+{
+	Cfg g = s->g;
+	Flow f = s->f;
+	Block * p = &(g->block[b]);
+	int mark = logTop;
+	int i, j, k, d, t;
+
+	for (j = s->phiFirst[b]; j < s->phiFirst[b + 1]; j++)
+		setCur(s->phi[j].sym, s->phi[j].value);
+
+	for (i = p->first; i <= p->last; i++) {
+		if (!ISACTIVE(q[i].num)) continue;
+		SSA_USEX(s, i) = useOf(s, q[i].x);
+		SSA_USEY(s, i) = useOf(s, q[i].y);
+		if (q[i].z->type == OPERAND_DEREFERENCE) SSA_USEZ(s, i) = useOf(s, q[i].z);
+		if ((d = quadDef(f, i)) >= 0) {
+			if (q[i].op == O_PAR) SSA_USEX(s, i) = -1;		//par x, RET does not read x
+			SSA_DEF(s, i) = newValue(s, d, i);
+			setCur(d, SSA_DEF(s, i));
+		}
+		else if ((k = refArgument(f, i)) >= 0)
+			setCur(k, SSA_UNKNOWN);
+		else if (writesVariables(f, i))
+			for (k = 0; k < f->symNum; k++)
+				if (SET_HAS(f->vars, k)) setCur(k, SSA_UNKNOWN);
+	}
+
+	for (t = 0; t < 2; t++) {
+		int succ = p->succ[t];
+		if (succ < 0) continue;
+		Block * sp = &(g->block[succ]);
+		for (j = 0; j < sp->predNum && sp->pred[j] != b; j++) ;
+		if (j == sp->predNum) continue;
+		for (k = s->phiFirst[succ]; k < s->phiFirst[succ + 1]; k++)
+			s->phi[k].arg[j] = cur[s->phi[k].sym];
+	}
+
+	for (j = 0; j < children[b].n; j++)
+		renameBlock(s, children, children[b].a[j]);
+
+	while (logTop > mark) {
+		logTop--;
+		cur[logSym[logTop]] = logValue[logTop];
+	}
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------ Def - use --------------------------
+   ------------------------------------------------------------- */
+
+static void addUsers(Ssa s, int v, int user, bool count)
+{
+	if (v < 0) return;
+	if (count)	s->userFirst[v]++;
+	else		s->user[--s->userFirst[v]] = user;
+}
+
+static void findUsers(Ssa s)
+{
+	Cfg g = s->g;
+	int n = g->last - g->first + 1;
+	int v, i, j, a, pass, total;
+	s->userFirst = (int *) new((s->valueNum + 1) * sizeof(int));
+	for (v = 0; v <= s->valueNum; v++) s->userFirst[v] = 0;
+	s->user = NULL;
+	//counted first, then placed backwards from the end of the range of each value
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < n; i++) {
+			addUsers(s, s->useX[i], i, pass == 0);
+			addUsers(s, s->useY[i], i, pass == 0);
+			addUsers(s, s->useZ[i], i, pass == 0);
+		}
+		for (j = 0; j < s->phiNum; j++)
+			for (a = 0; a < g->block[s->phi[j].block].predNum; a++)
+				addUsers(s, s->phi[j].arg[a], -(j + 1), pass == 0);
+		if (pass == 0) {
+			total = 0;
+			for (v = 0; v <= s->valueNum; v++) {
+				total += s->userFirst[v];
+				s->userFirst[v] = total;
+			}
+			s->user = (int *) new((total + 1) * sizeof(int));
+		}
+	}
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- Interface -------------------------
+   ------------------------------------------------------------- */
+
+Ssa buildSsa(Cfg g)
+{
+	int n = g->last - g->first + 1;
+	int i, b;
+	Ssa s = (Ssa) new(sizeof(struct Ssa_tag));
+	s->g = g;
+	computeDominators(g);
+	s->f = newFlow(g);
+	computeLiveness(s->f);
+	placePhis(s);
+
+	s->valueSym	= (int *) new((s->phiNum + n + 1) * sizeof(int));
+	s->valueDef	= (int *) new((s->phiNum + n + 1) * sizeof(int));
+	s->def		= (int *) new(n * sizeof(int));
+	s->useX		= (int *) new(n * sizeof(int));
+	s->useY		= (int *) new(n * sizeof(int));
+	s->useZ		= (int *) new(n * sizeof(int));
+	for (i = 0; i < n; i++) s->def[i] = s->useX[i] = s->useY[i] = s->useZ[i] = -1;
+	s->valueNum = 0;
+	newValue(s, -1, 0);		//SSA_UNKNOWN
+	for (i = 0; i < s->phiNum; i++)
+		s->phi[i].value = newValue(s, s->phi[i].sym, -(i + 1));
+
+	IntList * children = newLists(g->blockNum);
+	for (b = 0; b < g->blockNum; b++)
+		if (g->block[b].idom >= 0) add(&(children[g->block[b].idom]), b);
+	cur = (int *) new((s->f->symNum + 1) * sizeof(int));
+	for (i = 0; i < s->f->symNum; i++) cur[i] = SSA_UNKNOWN;
+	logSize		= 64;
+	logTop		= 0;
+	logSym		= (int *) new(logSize * sizeof(int));
+	logValue	= (int *) new(logSize * sizeof(int));
+	renameBlock(s, children, 0);
+	delete(cur);
+	delete(logSym);
+	delete(logValue);
+	deleteLists(children, g->blockNum);
+
+	findUsers(s);
+	#ifdef DEBUG
+	printf("ssa: unit of quads %d-%d, %d values, %d phis\n", g->first, g->last, s->valueNum, s->phiNum);
+	#endif
+	return s;
+}
+
+void deleteSsa(Ssa s)
+{
+	int i;
+	if (s == NULL) return;
+	for (i = 0; i < s->phiNum; i++) delete(s->phi[i].arg);
+	delete(s->phi);
+	delete(s->phiFirst);
+	delete(s->valueSym);
+	delete(s->valueDef);
+	delete(s->def);
+	delete(s->useX);
+	delete(s->useY);
+	delete(s->useZ);
+	delete(s->userFirst);
+	delete(s->user);
+	deleteFlow(s->f);
+	delete(s);
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ *
+ *  C header file : ssa.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Static single assignment form of the quads of a unit
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __SSA_H__
+#define __SSA_H__
+
+#include "cfg.h"
+#include "dataflow.h"
+
+/* The quads are not rewritten: the form is kept next to them. Every definition of a local
+ * (variable, parameter by value or temporary, see dataflow.h) is a value, and so is every phi,
+ * placed where the definitions of a local meet and it is still live (pruned SSA).
+ * Each read of a local refers to the one value that reaches it.
+ * Value SSA_UNKNOWN stands for what the unit does not define itself: the locals at the entry
+ * of the unit, and the variables after a call that may write them (a call to a function
+ * nested in the unit, or an argument by reference). */
+
+#define SSA_UNKNOWN 0
+
+/* ---------------------------------------------------------------------
+   --------------------------- Ορισμός τύπων ---------------------------
+   --------------------------------------------------------------------- */
+
+typedef struct Phi_tag {
+	int		block;
+	int		sym;		//flowIndex of the local
+	int		value;
+	int *	arg;		//arg[j]: the value coming from the j-th predecessor of the block
+} Phi;
+
+typedef struct Ssa_tag {
+	Cfg		g;
+	Flow	f;
+	int		valueNum;
+	int *	valueSym;	//flowIndex of the local of every value, -1 for SSA_UNKNOWN
+	int *	valueDef;	//quad that defines every value, or -(phi + 1), 0 for SSA_UNKNOWN
+	int *	def;		//def[i - first]: value defined by q[i], -1 if none
+	int *	useX;		//value read by q[i] as x, or as the pointer of [x], -1 if none
+	int *	useY;		//the same for y
+	int *	useZ;		//the same for the pointer of [z]
+	Phi *	phi;
+	int		phiNum;
+	int *	phiFirst;	//the phis of block b are phi[phiFirst[b]] ... phi[phiFirst[b+1]-1]
+	int *	userFirst;	//the users of value v are user[userFirst[v]] ... user[userFirst[v+1]-1]:
+	int *	user;		//i - first for a quad, -(p + 1) for a phi
+} * Ssa;
+
+/* ---------------------------------------------------------------------
+   --------------- Πρωτότυπα των βοηθητικών συναρτήσεων ----------------
+   --------------------------------------------------------------------- */
+
+Ssa		buildSsa		(Cfg g);	/* computes dominators and liveness of g */
+void	deleteSsa		(Ssa s);
+
+#define SSA_DEF(S,I)	((S)->def[(I) - (S)->g->first])
+#define SSA_USEX(S,I)	((S)->useX[(I) - (S)->g->first])
+#define SSA_USEY(S,I)	((S)->useY[(I) - (S)->g->first])
+#define SSA_USEZ(S,I)	((S)->useZ[(I) - (S)->g->first])
+
+#endif
@@ -44,13 +44,29 @@ unsigned int   tempNumber;             /* Αρίθμηση των temporaries
 
 static unsigned int   hashTableSize;   /* Μέγεθος πίνακα κατακερματισμού */
 static SymbolEntry ** hashTable;       /* Πίνακας κατακερματισμού        */
+static unsigned int   hashEntries;     /* Εγγραφές στον πίνακα           */
+
+#define MAX_LOAD_FACTOR 2              /* Μέγιστος μέσος όρος εγγραφών ανά κάδο */
+#define BUCKET(H) ((H) % hashTableSize)
+
+#define IDENT_POOL_SIZE 1024           /* Αρχικό μέγεθος (δύναμη του 2)  */
+
+static unsigned int   identPoolSize = 0; /* Κάδοι του identifier pool    */
+static unsigned int   identNum      = 0; /* Πλήθος αναγνωριστικών         */
+static Ident       ** identPool;         /* Identifier pool               */
+
+#define CONST_POOL_SIZE 256            /* Αρχικό μέγεθος (δύναμη του 2)  */
+
+static unsigned int   constPoolSize = 0; /* Μέγεθος του constant pool    */
+static unsigned int   constNum      = 0; /* Πλήθος σταθερών               */
+static SymbolEntry ** constPool;         /* Constant pool                 */
 
 static struct Type_tag typeConst [] = {
-    { TYPE_VOID,    NULL, 0, 0 },
-    { TYPE_INTEGER, NULL, 0, 0 },
-    { TYPE_BOOLEAN, NULL, 0, 0 },
-    { TYPE_CHAR,    NULL, 0, 0 },
-    { TYPE_ANY,     NULL, 0, 0 },
+    { TYPE_VOID,    NULL, 0, 0, false, { NULL } },
+    { TYPE_INTEGER, NULL, 0, 0, false, { NULL } },
+    { TYPE_BOOLEAN, NULL, 0, 0, false, { NULL } },
+    { TYPE_CHAR,    NULL, 0, 0, false, { NULL } },
+    { TYPE_ANY,     NULL, 0, 0, true,  { NULL } },
 };
 
 const Type typeVoid    = &(typeConst[0]);
@@ -64,8 +80,6 @@ const Type typeAny	   = &(typeConst[4]);
    ------- Υλοποίηση βοηθητικών συναρτήσεων του πίνακα συμβόλων --------
    --------------------------------------------------------------------- */
 
-typedef unsigned long int HashType;
-
 static HashType PJW_hash (const char * key)
 {
     /*
@@ -132,6 +146,58 @@ void strAppendString (char * buffer, RepString str)
 }
 
 
+/* ---------------------------------------------------------------------
+   ------------ Υλοποίηση του identifier pool (our addition) -----------
+   --------------------------------------------------------------------- */
+
+static void growIdentPool ()
+{
+    unsigned int   newSize = (identPoolSize == 0) ? IDENT_POOL_SIZE : 2 * identPoolSize;
+    Ident       ** newPool = (Ident **) new(newSize * sizeof(Ident *));
+    unsigned int   i;
+
+    for (i = 0; i < newSize; i++)
+        newPool[i] = NULL;
+    for (i = 0; i < identPoolSize; i++) {
+        Ident * id = identPool[i];
+        while (id != NULL) {
+            Ident * next = id->next;
+            id->next = newPool[id->hash & (newSize - 1)];
+            newPool[id->hash & (newSize - 1)] = id;
+            id = next;
+        }
+    }
+    if (identPoolSize != 0)
+        delete(identPool);
+    identPool     = newPool;
+    identPoolSize = newSize;
+}
+
+/* Returns the unique copy of name in the pool, inserting it if it is not there yet.
+ * Called by the lexer for every identifier, so that the name is hashed only once */
+const char * intern (const char * name)
+{
+    HashType  hash = PJW_hash(name);
+    Ident   * id;
+
+    if (identPoolSize == 0)
+        growIdentPool();
+    for (id = identPool[hash & (identPoolSize - 1)]; id != NULL; id = id->next)
+        if (id->hash == hash && strcmp(id->str, name) == 0)
+            return id->str;
+
+    if (identNum >= identPoolSize)
+        growIdentPool();
+    id = (Ident *) arenaAlloc(globalArena, sizeof(Ident) + strlen(name) + 1);
+    strcpy(id->str, name);
+    id->hash = hash;
+    id->num  = identNum++;
+    id->next = identPool[hash & (identPoolSize - 1)];
+    identPool[hash & (identPoolSize - 1)] = id;
+    return id->str;
+}
+
+
 /* ---------------------------------------------------------------------
    ------ Υλοποίηση των συναρτήσεων χειρισμού του πίνακα συμβόλων ------
    --------------------------------------------------------------------- */
@@ -149,18 +215,90 @@ void initSymbolTable (unsigned int size)
     /* Αρχικοποίηση του πίνακα κατακερματισμού */
     
     hashTableSize = size;
+    hashEntries   = 0;
     hashTable = (SymbolEntry **) new(size * sizeof(SymbolEntry *));
     
     for (i = 0; i < size; i++)
         hashTable[i] = NULL;
 }
 
+#ifdef DEBUG
+/* Our addition: chain length statistics of the hash table */
+static void printHashStats (const char * when)
+{
+    unsigned int i, used = 0, longest = 0;
+
+    for (i = 0; i < hashTableSize; i++) {
+        unsigned int  len = 0;
+        SymbolEntry * e;
+
+        for (e = hashTable[i]; e != NULL; e = e->nextHash)
+            len++;
+        if (len > 0) used++;
+        if (len > longest) longest = len;
+    }
+    printf("hashTable %s: %u entries in %u buckets (load %.2f), %u used, longest chain %u, average chain %.2f\n",
+           when, hashEntries, hashTableSize, (double) hashEntries / hashTableSize,
+           used, longest, used ? (double) hashEntries / used : 0.0);
+}
+#endif
+
+/* Our addition: grows the hash table when the load factor gets too high.
+ * Every chain must keep the newest entry first, as closeScope() unlinks the entries of the
+ * current scope from the heads of the chains and LOOKUP_CURRENT_SCOPE stops at the first
+ * entry of an outer scope. So the entries are reinserted scope by scope, from the innermost 
+ * scope outwards and from the newest entry to the oldest, each one at the tail of its chain */
+static void growHashTable ()
+{
+    unsigned int   newSize = 2 * hashTableSize + 1;
+    SymbolEntry ** tails   = (SymbolEntry **) new(newSize * sizeof(SymbolEntry *));
+    Scope        * scope;
+    unsigned int   i;
+
+    #ifdef DEBUG
+    printHashStats("before growing");
+    #endif
+
+    delete(hashTable);
+    hashTableSize = newSize;
+    hashTable = (SymbolEntry **) new(newSize * sizeof(SymbolEntry *));
+    for (i = 0; i < newSize; i++)
+        hashTable[i] = tails[i] = NULL;
+
+    for (scope = currentScope; scope != NULL; scope = scope->parent) {
+        SymbolEntry * e;
+
+        for (e = scope->entries; e != NULL; e = e->nextInScope) {
+            unsigned int b = BUCKET(e->hashValue);
+
+            if (e->entryType == ENTRY_TEMPORARY)
+                continue;
+
+            e->nextHash = NULL;
+            if (tails[b] == NULL)
+                hashTable[b] = e;
+            else
+                tails[b]->nextHash = e;
+            tails[b] = e;
+        }
+    }
+    delete(tails);
+
+    #ifdef DEBUG
+    printHashStats("after growing");
+    #endif
+}
+
 void destroySymbolTable ()
 {
     unsigned int i;
     
     /* Καταστροφή του πίνακα κατακερματισμού */
     
+    #ifdef DEBUG
+    printHashStats("at exit");
+    #endif
+
     for (i = 0; i < hashTableSize; i++)
         if (hashTable[i] != NULL)
             destroyEntry(hashTable[i]);
@@ -175,6 +313,7 @@ void openScope ()
     newScope->negOffset = START_NEGATIVE_OFFSET;
     newScope->parent    = currentScope;
     newScope->entries   = NULL;
+    newScope->mark      = arenaMark(unitArena);
 
     if (currentScope == NULL)
         newScope->nestingLevel = 1;
@@ -195,7 +334,10 @@ void closeScope ()
     while (e != NULL) {
         SymbolEntry * next = e->nextInScope;
         
-        hashTable[e->hashValue] = e->nextHash;
+        if (e->entryType != ENTRY_TEMPORARY) {     /* δεν είναι στον Π.Κ. */
+            hashTable[BUCKET(e->hashValue)] = e->nextHash;
+            hashEntries--;
+        }
 		/* ATTENTION: We commented the following line to retain SymbolEntries in heap
 		 *			  since they are necessary for final code generation
 		 */
@@ -207,33 +349,66 @@ void closeScope ()
     delete(t);
 }
 
+/* Our addition: closes the current scope and also releases everything allocated in unitArena
+ * since the scope was opened (its variables and temporaries, the operands and lists of its quads).
+ * Used in streaming mode, where the final code of the unit has already been generated when its
+ * scope closes. Functions and parameters are in globalArena, since the final code of the program
+ * refers to them until the end */
+void releaseScope ()
+{
+    SymbolEntry * e = currentScope->entries;
+    Scope       * t = currentScope;
+    
+    while (e != NULL) {
+        SymbolEntry * next = e->nextInScope;
+        
+        if (e->entryType != ENTRY_TEMPORARY) {     /* δεν είναι στον Π.Κ. */
+            hashTable[BUCKET(e->hashValue)] = e->nextHash;
+            hashEntries--;
+        }
+        if (e->entryType != ENTRY_FUNCTION)
+            destroyEntry(e);
+        e = next;
+    }
+    
+    currentScope = currentScope->parent;
+    arenaRelease(unitArena, t->mark);
+    delete(t);
+}
+
 static void insertEntry (SymbolEntry * e)
 {
-    e->nextHash             = hashTable[e->hashValue];
-    hashTable[e->hashValue] = e;
-    e->nextInScope          = currentScope->entries;
-    currentScope->entries   = e;
+    unsigned int b = BUCKET(e->hashValue);
+
+    e->nextHash           = hashTable[b];
+    hashTable[b]          = e;
+    e->nextInScope        = currentScope->entries;
+    currentScope->entries = e;
+
+    if (++hashEntries > MAX_LOAD_FACTOR * hashTableSize)
+        growHashTable();
 }
 
-static SymbolEntry * newEntry (const char * name)
+/* Our addition: the entry is allocated in arena a, globalArena for functions and parameters
+ * that must outlive their scope, unitArena for everything else */
+static SymbolEntry * newEntry (const char * name, Arena a)
 {
     SymbolEntry * e;
     
     /* Έλεγχος αν υπάρχει ήδη στο τρέχον scope */
     
-    for (e = currentScope->entries; e != NULL; e = e->nextInScope)
-        if (strcmp(name, e->id) == 0) {
-            error("Duplicate identifier: %s", name);
-            return NULL;
-        }
+    if (lookupEntry(name, LOOKUP_CURRENT_SCOPE, false) != NULL) {
+        error("Duplicate identifier: %s", name);
+        return NULL;
+    }
 
     /* Αρχικοποίηση όλων εκτός: entryType και u */
 
-    e = (SymbolEntry *) new(sizeof(SymbolEntry));
-    e->id = (const char *) new(strlen(name) + 1);
-
-    strcpy((char *) (e->id), name);
-    e->hashValue    = PJW_hash(name) % hashTableSize;
+    e = (SymbolEntry *) arenaAlloc(a, sizeof(SymbolEntry));
+    e->id           = name;             /* interned, points in the pool */
+    e->operand[0]   = e->operand[1] = e->operand[2] = e->operand[3] = NULL;
+    e->flowIndex    = -1;
+    e->hashValue    = IDENT(name)->hash; /* not reduced, the table may grow */
     e->nestingLevel = currentScope->nestingLevel;
     insertEntry(e);
     return e;
@@ -241,7 +416,7 @@ static SymbolEntry * newEntry (const char * name)
 
 SymbolEntry * newVariable (const char * name, Type type)
 {
-    SymbolEntry * e = newEntry(name);
+    SymbolEntry * e = newEntry(name, unitArena);
     
     if (e != NULL) {
         e->entryType = ENTRY_VARIABLE;
@@ -253,18 +428,75 @@ SymbolEntry * newVariable (const char * name, Type type)
     return e;
 }
 
+/* Our addition: constant pool
+ * Each constant exists only once, in a pool with open addressing (linear probing) that is
+ * keyed by the kind of its type and its value. Constants are not inserted in the hash table
+ * of identifiers nor in any scope, they live until the end of the compilation and their
+ * names are built only when they are printed (see entryName()) */
+
+typedef union {
+    RepInteger vInteger;
+    RepBoolean vBoolean;
+    RepChar    vChar;
+    RepString  vString;
+} ConstValue;
+
+static HashType constHash (int kind, ConstValue * value)
+{
+    HashType h;
+
+    switch (kind) {
+        case TYPE_INTEGER: h = (HashType) (unsigned int) value->vInteger; break;
+        case TYPE_BOOLEAN: h = value->vBoolean;                           break;
+        case TYPE_CHAR:    h = (unsigned char) value->vChar;              break;
+        case TYPE_IARRAY:  h = PJW_hash(value->vString);                  break;
+        default:           h = 0;                                         break;
+    }
+    return (h * 2654435761UL) ^ kind;
+}
+
+static bool constEqual (SymbolEntry * e, int kind, ConstValue * value)
+{
+    if (e->u.eConstant.type->kind != kind)
+        return false;
+    switch (kind) {
+        case TYPE_INTEGER: return e->u.eConstant.value.vInteger == value->vInteger;
+        case TYPE_BOOLEAN: return e->u.eConstant.value.vBoolean == value->vBoolean;
+        case TYPE_CHAR:    return e->u.eConstant.value.vChar    == value->vChar;
+        case TYPE_IARRAY:  return strcmp(e->u.eConstant.value.vString, value->vString) == 0;
+        default:           return true;              /* μόνο η σταθερά nil */
+    }
+}
+
+static void growConstPool ()
+{
+    unsigned int    oldSize = constPoolSize;
+    SymbolEntry  ** oldPool = constPool;
+    unsigned int    i;
+
+    constPoolSize = (oldSize == 0) ? CONST_POOL_SIZE : 2 * oldSize;
+    constPool = (SymbolEntry **) new(constPoolSize * sizeof(SymbolEntry *));
+    for (i = 0; i < constPoolSize; i++)
+        constPool[i] = NULL;
+    for (i = 0; i < oldSize; i++)
+        if (oldPool[i] != NULL) {
+            unsigned int j = oldPool[i]->hashValue & (constPoolSize - 1);
+
+            while (constPool[j] != NULL)
+                j = (j + 1) & (constPoolSize - 1);
+            constPool[j] = oldPool[i];
+        }
+    delete(oldPool);
+}
+
 SymbolEntry * newConstant (const char * name, Type type, ...)
 {
     SymbolEntry * e;
+    ConstValue    value;
+    HashType      hash;
+    unsigned int  i;
     va_list ap;
 
-    union {
-        RepInteger vInteger;
-        RepBoolean vBoolean;
-        RepChar    vChar;
-        RepString  vString;
-    } value;
-    
     va_start(ap, type);
     switch (type->kind) {
         case TYPE_INTEGER:
@@ -278,63 +510,39 @@ SymbolEntry * newConstant (const char * name, Type type, ...)
             break;
 		case TYPE_IARRAY:
             if (equalType(type->refType, typeChar)) {
-                RepString str = va_arg(ap, RepString);
-                
-                value.vString = (const char *) new(strlen(str) + 1);
-                strcpy((char *) (value.vString), str);
+                value.vString = va_arg(ap, RepString);
                 break;
             }
 		case TYPE_LIST:
 			//only nil list can exist as a list constant, no need to parse va_list
-			if(strcmp(name,"nil")!=0) internal("newConstant(): invalid list constant");
+			if(name==NULL || strcmp(name,"nil")!=0) internal("newConstant(): invalid list constant");
 			break;
         default:
             internal("Invalid type for constant");
     }
     va_end(ap);
 
-    if (name == NULL) {
-        char buffer[256];
-        
-        switch (type->kind) {
-            case TYPE_INTEGER:
-                sprintf(buffer, "%d", value.vInteger);
-                break;
-            case TYPE_BOOLEAN:
-                if (value.vBoolean)
-                    sprintf(buffer, "true");
-                else
-                    sprintf(buffer, "false");
-                break;
-            case TYPE_CHAR:
-                strcpy(buffer, "'");
-                strAppendChar(buffer, value.vChar);
-                strcat(buffer, "'");
-                break;
-            case TYPE_IARRAY:
-                strcpy(buffer, "\"");
-                strAppendString(buffer, value.vString);
-                strcat(buffer, "\"");           
-        }
-		/* Our addition: Construct only one instance for each different value */
-		e = lookupEntry(buffer,LOOKUP_ALL_SCOPES,false);
-		if(e==NULL)	
-	        e = newEntry(buffer);
-		else
-			return e;
-    }
-    else{
-		/* Our addition: Construct only one instance for each different value */
-		e = lookupEntry(name,LOOKUP_ALL_SCOPES,false);
-		if(e==NULL)	
-			e = newEntry(name);
-		else 
-			return e;
-    }
+	/* Our addition: Construct only one instance for each different value */
+    if (constNum >= constPoolSize / 2)
+        growConstPool();
+    hash = constHash(type->kind, &value);
+    for (i = hash & (constPoolSize - 1); constPool[i] != NULL; i = (i + 1) & (constPoolSize - 1))
+        if (constPool[i]->hashValue == (unsigned int) hash && constEqual(constPool[i], type->kind, &value))
+            return constPool[i];
+
+    e = (SymbolEntry *) arenaAlloc(globalArena, sizeof(SymbolEntry));
+    e->id           = NULL;               /* built lazily by entryName() */
+    e->operand[0]   = e->operand[1] = e->operand[2] = e->operand[3] = NULL;
+    e->flowIndex    = -1;
+    e->hashValue    = hash;
+    e->nestingLevel = 0;
+    e->nextHash     = NULL;
+    e->nextInScope  = NULL;
+    constPool[i] = e;
+    constNum++;
 
 	#ifdef DEBUG
 	printf("newConstant: ");
-	if(e==NULL) {printf("is null\n"); return NULL;}
 	printType(type);
 	switch (type->kind) {
 		case TYPE_INTEGER:
@@ -348,32 +556,31 @@ SymbolEntry * newConstant (const char * name, Type type, ...)
 			break;
 		case TYPE_IARRAY:
 			printf("%s",value.vString);
+			break;
 		case TYPE_LIST:
 			printf("nil");
 	}
 	printf(" --\n");
 	#endif
 	
-    if (e != NULL) {
-        e->entryType = ENTRY_CONSTANT;
-        e->u.eConstant.type = type;
-        type->refCount++;
-        switch (type->kind) {
-            case TYPE_INTEGER:
-                e->u.eConstant.value.vInteger = value.vInteger;
-                break;
-            case TYPE_BOOLEAN:
-                e->u.eConstant.value.vBoolean = value.vBoolean;
-                break;
-            case TYPE_CHAR:
-                e->u.eConstant.value.vChar = value.vChar;
-                break;
-			case TYPE_IARRAY:
-                e->u.eConstant.value.vString = value.vString;
-				break;
-			case TYPE_LIST:
-				break; //no need to provide a value, only nil constant existent for lists
-        }
+    e->entryType = ENTRY_CONSTANT;
+    e->u.eConstant.type = type;
+    type->refCount++;
+    switch (type->kind) {
+        case TYPE_INTEGER:
+            e->u.eConstant.value.vInteger = value.vInteger;
+            break;
+        case TYPE_BOOLEAN:
+            e->u.eConstant.value.vBoolean = value.vBoolean;
+            break;
+        case TYPE_CHAR:
+            e->u.eConstant.value.vChar = value.vChar;
+            break;
+		case TYPE_IARRAY:
+            e->u.eConstant.value.vString = arenaStrdup(globalArena, value.vString);
+			break;
+		case TYPE_LIST:
+			break; //no need to provide a value, only nil constant existent for lists
     }
     return e;
 }
@@ -386,7 +593,7 @@ SymbolEntry * newFunction (const char * name)
     SymbolEntry * e = lookupEntry(name, LOOKUP_CURRENT_SCOPE, false);
 
     if (e == NULL) {
-        e = newEntry(name);
+        e = newEntry(name, globalArena);
         if (e != NULL) {
             e->entryType = ENTRY_FUNCTION;
             e->u.eFunction.isForward = false;
@@ -417,7 +624,7 @@ SymbolEntry * newParameter (const char * name, Type type,
         internal("Cannot add a parameter to a non-function");
     switch (f->u.eFunction.pardef) {
         case PARDEF_DEFINE:
-            e = newEntry(name);
+            e = newEntry(name, globalArena);
             if (e != NULL) {
                 e->entryType = ENTRY_PARAMETER;
                 e->u.eParameter.type = type;
@@ -447,7 +654,7 @@ SymbolEntry * newParameter (const char * name, Type type,
             else if (e->u.eParameter.mode != mode)
                 error("Parameter passing mode mismatch in redeclaration "
                       "of function %s", f->id);
-            else if (strcmp(e->id, name) != 0)
+            else if (e->id != name)
                 error("Parameter name mismatch in redeclaration "
                       "of function %s", f->id);
             else
@@ -493,10 +700,11 @@ void endFunctionHeader (SymbolEntry * f, Type type)
             internal("Cannot end parameters in an already defined function");
             break;
         case PARDEF_DEFINE:
-			//4 next lines are our addition
+			//5 next lines are our addition
 			f->u.eFunction.serialNum = maxSerialNum++;
             f->u.eFunction.posOffset = fixOffset(f->u.eFunction.firstArgument);
 			f->u.eFunction.gcHungry = false;
+			f->u.eFunction.locals = NULL;
             f->u.eFunction.resultType = type;
             type->refCount++;
             break;
@@ -515,25 +723,92 @@ void endFunctionHeader (SymbolEntry * f, Type type)
     f->u.eFunction.pardef = PARDEF_COMPLETE;
 }
 
+/* Our addition: temporaries are never looked up by name, so they are not inserted in the
+ * hash table and get no name at all (see entryName()). They are only kept in the entries
+ * of the scope, as the call tables of the garbage collector need them */
 SymbolEntry * newTemporary (Type type)
 {
-    char buffer[10];
-    SymbolEntry * e;
+    SymbolEntry * e = (SymbolEntry *) arenaAlloc(unitArena, sizeof(SymbolEntry));
 
-    sprintf(buffer, "$%d", tempNumber);
-    e = newEntry(buffer);
-    
-    if (e != NULL) {
-        e->entryType = ENTRY_TEMPORARY;
-        e->u.eVariable.type = type;
-        type->refCount++;
-        currentScope->negOffset -= sizeOfType(type);
-        e->u.eTemporary.offset = currentScope->negOffset;
-        e->u.eTemporary.number = tempNumber++;
-    }
+    e->id           = NULL;
+    e->operand[0]   = e->operand[1] = e->operand[2] = e->operand[3] = NULL;
+    e->flowIndex    = -1;
+    e->hashValue    = 0;
+    e->nextHash     = NULL;
+    e->nestingLevel = currentScope->nestingLevel;
+    e->nextInScope        = currentScope->entries;
+    currentScope->entries = e;
+
+    e->entryType = ENTRY_TEMPORARY;
+    e->u.eTemporary.type = type;
+    type->refCount++;
+    currentScope->negOffset -= sizeOfType(type);
+    e->u.eTemporary.offset = currentScope->negOffset;
+    e->u.eTemporary.number = tempNumber++;
+    e->u.eTemporary.reg = -1;
     return e;
 }
 
+/* Our addition: a temporary of function f made by the optimizer, when its scope may have closed
+ * already (not in streaming mode). Its slot is below all the others of f. It is kept in the
+ * locals of f, and in the entries of its scope if that is still open, for releaseScope() */
+SymbolEntry * newUnitTemporary (SymbolEntry * f, Type type)
+{
+    SymbolEntry * e = (SymbolEntry *) arenaAlloc(unitArena, sizeof(SymbolEntry));
+
+    e->id           = NULL;
+    e->operand[0]   = e->operand[1] = e->operand[2] = e->operand[3] = NULL;
+    e->flowIndex    = -1;
+    e->hashValue    = 0;
+    e->nextHash     = NULL;
+    e->nestingLevel = f->nestingLevel + 1;
+    if (currentScope != NULL && currentScope->entries == f->u.eFunction.locals &&
+        currentScope->nestingLevel == e->nestingLevel)
+        currentScope->entries = e;
+    e->nextInScope  = f->u.eFunction.locals;
+    f->u.eFunction.locals = e;
+
+    e->entryType = ENTRY_TEMPORARY;
+    e->u.eTemporary.type = type;
+    type->refCount++;
+    f->u.eFunction.negOffset -= sizeOfType(type);
+    e->u.eTemporary.offset = f->u.eFunction.negOffset;
+    e->u.eTemporary.number = tempNumber++;
+    e->u.eTemporary.reg = -1;
+    return e;
+}
+
+/* Our addition: the printable name of an entry. Names of temporaries ($number) and
+ * constants are only built here, in one of a few static buffers that are reused in turn */
+const char * entryName (SymbolEntry * e)
+{
+    static char  buffer[8][12];
+    static int   next = 0;
+    char       * p;
+
+    if (e->id != NULL)
+        return e->id;
+    if (e->entryType == ENTRY_CONSTANT)
+        switch (e->u.eConstant.type->kind) {
+            case TYPE_BOOLEAN: return e->u.eConstant.value.vBoolean ? "true" : "false";
+            case TYPE_IARRAY:  return e->u.eConstant.value.vString;  /* με τα εισαγωγικά */
+            case TYPE_LIST:    return "nil";
+            default:           break;
+        }
+    p = buffer[next];
+    next = (next + 1) % 8;
+    if (e->entryType == ENTRY_TEMPORARY)
+        sprintf(p, "$%d", e->u.eTemporary.number);
+    else if (e->u.eConstant.type->kind == TYPE_INTEGER)
+        sprintf(p, "%d", e->u.eConstant.value.vInteger);
+    else {
+        strcpy(p, "'");
+        strAppendChar(p, e->u.eConstant.value.vChar);
+        strcat(p, "'");
+    }
+    return p;
+}
+
 void destroyEntry (SymbolEntry * e)
 {
     SymbolEntry * args;
@@ -543,19 +818,13 @@ void destroyEntry (SymbolEntry * e)
             destroyType(e->u.eVariable.type);
             break;
         case ENTRY_CONSTANT:
-            if (e->u.eConstant.type->kind == TYPE_IARRAY)
-                delete((char *) (e->u.eConstant.value.vString));
             destroyType(e->u.eConstant.type);
             break;
         case ENTRY_FUNCTION:
             args = e->u.eFunction.firstArgument;
             while (args != NULL) {
-                SymbolEntry * p = args;
-                
                 destroyType(args->u.eParameter.type);
-                delete((char *) (args->id));
                 args = args->u.eParameter.next;
-                delete(p);
             }
             destroyType(e->u.eFunction.resultType);
             break;
@@ -566,26 +835,25 @@ void destroyEntry (SymbolEntry * e)
             destroyType(e->u.eTemporary.type);
             break;
     }
-    delete((char *) (e->id));
-    delete(e);        
+    /* η ίδια η εγγραφή (και το id της) ανήκει σε arena και ελευθερώνεται με αυτήν */
 }
 
 SymbolEntry * lookupEntry (const char * name, LookupType type, bool err)
 {
-    unsigned int  hashValue = PJW_hash(name) % hashTableSize;
-    SymbolEntry * e         = hashTable[hashValue];
+    unsigned int  hashValue = IDENT(name)->hash;
+    SymbolEntry * e         = hashTable[BUCKET(hashValue)];
     
     switch (type) {
         case LOOKUP_CURRENT_SCOPE:
             while (e != NULL && e->nestingLevel == currentScope->nestingLevel)
-                if (strcmp(e->id, name) == 0)
+                if (e->id == name)
                     return e;
                 else
                     e = e->nextHash;
             break;
         case LOOKUP_ALL_SCOPES:
             while (e != NULL)
-                if (strcmp(e->id, name) == 0)
+                if (e->id == name)
                     return e;
                 else
                     e = e->nextHash;
@@ -599,43 +867,44 @@ SymbolEntry * lookupEntry (const char * name, LookupType type, bool err)
     return NULL;
 }
 
-Type typeIArray (Type refType)
+/* Our addition: types are hash-consed. Every type keeps the types that are derived from it
+ * (array of, pointer to, list of), so each structural type is constructed only once and
+ * two types without TYPE_ANY are equal only if they are the same object. Canonical types
+ * are never destroyed */
+static Type derivedType (int kind, int slot, Type refType)
 {
-    Type n = (Type) new(sizeof(struct Type_tag));
+    Type n = refType->derived[slot];
+
+    if (n != NULL)
+        return n;
+
+    n = (Type) arenaAlloc(globalArena, sizeof(struct Type_tag));
+    n->kind       = kind;
+    n->refType    = refType;
+    n->size       = 0;
+    n->refCount   = 1;
+    n->hasAny     = refType->hasAny;
+    n->derived[0] = n->derived[1] = n->derived[2] = NULL;
 
-    n->kind     = TYPE_IARRAY;
-    n->refType  = refType;
-    n->refCount = 1;
-    
     refType->refCount++;
+    refType->derived[slot] = n;
 
     return n;
 }
 
-Type typePointer(Type refType)
+Type typeIArray (Type refType)
 {
-	Type n = (Type) new(sizeof(struct Type_tag));
-
-	n->kind		= TYPE_POINTER;
-	n->refType	= refType;
-	n->refCount = 1;
-
-	refType->refCount++;
+    return derivedType(TYPE_IARRAY, 0, refType);
+}
 
-	return n;
+Type typePointer(Type refType)
+{
+	return derivedType(TYPE_POINTER, 1, refType);
 }
 
 Type typeList (Type refType)
 {
-	Type n = (Type) new(sizeof(struct Type_tag));
-
-	n->kind		= TYPE_LIST;
-	n->refType	= refType;
-	n->refCount = 1;
-
-	refType->refCount++;
-
-	return n;
+	return derivedType(TYPE_LIST, 2, refType);
 }
 
 
@@ -671,8 +940,13 @@ bool equalType (Type type1, Type type2)
 	/* We added: a recursive typecheking for lists and arrays and
 	 *			 compatibility with TYPE_ANY that is always equal with any type except typeVoid
 	 */
+	if(type1==type2)
+		return true;
 	if((type1->kind==TYPE_ANY && type2->kind!=TYPE_VOID) || (type2->kind==TYPE_ANY && type1->kind!=TYPE_VOID))
 		return true;
+	/* types are hash-consed: different types can only match through TYPE_ANY */
+	if(!type1->hasAny && !type2->hasAny)
+		return false;
 
     if (type1->kind != type2->kind)
         return false;
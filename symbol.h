@@ -29,6 +29,9 @@
    --------------------------------------------------------------------- */
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "general.h"
 
 /*
  *  Αν το παραπάνω include δεν υποστηρίζεται από την υλοποίηση
@@ -52,6 +55,26 @@ typedef enum { false=0, true=1 } bool;
    --------------- Ορισμός τύπων του πίνακα συμβόλων -------------------
    --------------------------------------------------------------------- */
 
+/* Our addition: pool of interned identifiers
+ * Every identifier is stored once in the pool, together with its hash value and a unique
+ * serial number. Names passed to newEntry() and lookupEntry() (and so to newVariable(), 
+ * newFunction(), newParameter()) must have been returned by intern(), so that they can 
+ * be compared by pointer. SymbolEntry::id points in the pool. */
+
+typedef unsigned long int HashType;
+
+typedef struct Ident_tag Ident;
+
+struct Ident_tag {
+    HashType       hash;                 /* Τιμή κατακερματισμού      */
+    unsigned int   num;                  /* Μοναδικός αύξων αριθμός   */
+    Ident        * next;                 /* Επόμενο στον ίδιο κάδο    */
+    char           str[];                /* Το ίδιο το αναγνωριστικό  */
+};
+
+/* the Ident of an interned name */
+#define IDENT(NAME) ((Ident *) ((NAME) - offsetof(Ident, str)))
+
 /* Τύποι δεδομένων για την υλοποίηση των σταθερών */
 
 typedef int           RepInteger;         /* Ακέραιες                  */
@@ -78,6 +101,9 @@ struct Type_tag {
     Type           refType;              /* Τύπος αναφοράς            */
     RepInteger     size;                 /* Μέγεθος, αν είναι πίνακας */
     unsigned int   refCount;             /* Μετρητής αναφορών         */
+	/* our additions: types are hash-consed, each structural type exists only once */
+	bool		   hasAny;				 /* Αν περιέχει τον TYPE_ANY  */
+	Type		   derived[3];			 /* Μοναδικοί τύποι array of, pointer to, list of αυτόν */
 };
 
 
@@ -111,6 +137,8 @@ struct SymbolEntry_tag {
    unsigned int   hashValue;          /* Τιμή κατακερματισμού          */
    SymbolEntry  * nextHash;           /* Επόμενη εγγραφή στον Π.Κ.     */
    SymbolEntry  * nextInScope;        /* Επόμενη εγγραφή στην εμβέλεια */
+   struct Operand_tag * operand[4];   /* our addition: τα μοναδικά operands της εγγραφής (βλ. intermediate.c) */
+   int            flowIndex;          /* our addition: αριθμός στα σύνολα της ανάλυσης ροής, -1 εκτός αυτής (βλ. dataflow.c) */
 
    union {                            /* Ανάλογα με τον τύπο εγγραφής: */
 
@@ -143,6 +171,7 @@ struct SymbolEntry_tag {
 		 int			negOffset;			//bytes allocated in stack for variables and temporaries, updated before closeScope() of definitions
 		 int			serialNum;			//used for assembly numbering
 		 bool			gcHungry;			//used to discern if function calls garbage collector
+		 SymbolEntry *	locals;				//entries of its scope (variables, temporaries), set with negOffset
       } eFunction;
 
       struct {                                /****** Παράμετρος *******/
@@ -156,6 +185,7 @@ struct SymbolEntry_tag {
          Type          type;                  /* Τύπος                 */
          int           offset;                /* Offset στο Ε.Δ.       */
          int           number;
+         int           reg;                   /* our addition: register that holds it, -1 for its slot (βλ. regalloc.c) */
       } eTemporary;
 
    } u;                               /* Τέλος του union               */
@@ -174,6 +204,7 @@ struct Scope_tag {
 	/* our additions */
 	Type		   returnType;				 /* Τύπος επιστροφής δομικου μπλοκ που ορίζει την εμβέλεια */
 	bool		   gcHungry;				 /* Αν στο εν λόγω scope υπάρχει άμεση ή έμμεση κλήση στον garbage collector */
+	ArenaMark	   mark;					 /* Θέση του unitArena όταν άνοιξε η εμβέλεια */
 
 };
 
@@ -205,11 +236,14 @@ extern const Type typeAny;
    ------ Πρωτότυπα των συναρτήσεων χειρισμού του πίνακα συμβολών ------
    --------------------------------------------------------------------- */
 
+const char *  intern             (const char * name);
+
 void          initSymbolTable    (unsigned int size);
 void          destroySymbolTable (void);
 
 void          openScope          (void);
 void          closeScope         (void);
+void          releaseScope       (void);
 
 SymbolEntry * newVariable        (const char * name, Type type);
 SymbolEntry * newConstant        (const char * name, Type type, ...);
@@ -217,6 +251,8 @@ SymbolEntry * newFunction        (const char * name);
 SymbolEntry * newParameter       (const char * name, Type type,
                                   PassMode mode, SymbolEntry * f);
 SymbolEntry * newTemporary       (Type type);
+SymbolEntry * newUnitTemporary   (SymbolEntry * f, Type type);
+const char *  entryName          (SymbolEntry * e);
 
 void          forwardFunction    (SymbolEntry * f);
 void          endFunctionHeader  (SymbolEntry * f, Type type);
@@ -0,0 +1,351 @@
+/******************************************************************************
+
+ *  C code file   : valnum.c
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Local value numbering (common subexpressions in a basic block)
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "valnum.h"
+#include "cfg.h"
+#include "intermediate.h"
+#include "symbol.h"
+#include "general.h"
+#include "error.h"
+
+
+/* -------------------------------------------------------------
+   ---------------------- Value numbers ------------------------
+   ------------------------------------------------------------- */
+
+/* Symbols by what may change their value, apart from the quads that write them */
+typedef enum {
+	VN_CONST,		//constants: nothing
+	VN_TEMP,		//temporaries: nothing
+	VN_LOCAL,		//variables and parameters by value of the unit: calls (nested functions, by reference)
+	VN_MEMORY		//non-locals, parameters by reference, [x]: every store to memory and every call
+} VnClass;
+
+/* The table keeps the value number of symbols (op VN_SYMBOL), of expressions (op, a, b are the
+ * operator and the value numbers of the operands) and of loads [x] (op VN_LOAD, a is the value
+ * number of x). The entries of a symbol of class local/memory and of loads remember the epoch
+ * of their class when they were entered, and are valid only as long as it has not changed.
+ * The entries of previous blocks are those with an older stamp */
+#define VN_SYMBOL	(-1)
+#define VN_LOAD		(-2)
+
+typedef struct {
+	SymbolEntry *	sym;		//NULL for expressions and loads
+	int				op;
+	int				a, b;
+	int				vn;
+	unsigned int	epoch;
+	unsigned int	stamp;
+} VnEntry;
+
+static VnEntry *	table		= NULL;
+static unsigned int	tableSize	= 0;		//power of 2
+static unsigned int	tableUsed	= 0;
+static unsigned int	stamp		= 0;
+
+static SymbolEntry **	holder		= NULL;	//holder[vn]: the symbol written last with vn, if it still holds it
+static int				holderSize	= 0;
+static int				vnNext;
+
+static unsigned int	memEpoch	= 0;
+static unsigned int	callEpoch	= 0;
+static unsigned int	level;					//nesting level of the locals of the unit
+static bool			changed;
+
+
+static VnClass classOf(SymbolEntry * s)
+{
+	switch (s->entryType) {
+		case ENTRY_CONSTANT:	return VN_CONST;
+		case ENTRY_TEMPORARY:	return VN_TEMP;
+		case ENTRY_VARIABLE:	return s->nestingLevel == level ? VN_LOCAL : VN_MEMORY;
+		case ENTRY_PARAMETER:	return (s->nestingLevel == level && s->u.eParameter.mode == PASS_BY_VALUE) ? VN_LOCAL : VN_MEMORY;
+		default:				internal("valnum: classOf: unexpected entry type");
+	}
+	return VN_MEMORY;
+}
+
+static unsigned int epochOf(VnClass c)
+{
+	switch (c) {
+		case VN_LOCAL:	return callEpoch;
+		case VN_MEMORY:	return memEpoch;
+		default:		return 0;
+	}
+}
+
+static unsigned int hashKey(SymbolEntry * s, int op, int a, int b)
+{
+	unsigned long h = (unsigned long) s;
+	h = h * 31 + (unsigned int) op;
+	h = h * 31 + (unsigned int) a;
+	h = h * 31 + (unsigned int) b;
+	return (unsigned int) (h ^ (h >> 16));
+}
+
+static VnEntry * find(SymbolEntry * s, int op, int a, int b, bool insert);
+
+static void growTable()
+{
+	VnEntry * old = table;
+	unsigned int i, oldSize = tableSize;
+	tableSize = (oldSize == 0) ? 256 : 2 * oldSize;
+	table = (VnEntry *) new(tableSize * sizeof(VnEntry));
+	for (i = 0; i < tableSize; i++) table[i].stamp = stamp - 1;
+	tableUsed = 0;
+	for (i = 0; i < oldSize; i++)
+		if (old[i].stamp == stamp) *find(old[i].sym, old[i].op, old[i].a, old[i].b, true) = old[i];
+	delete(old);
+}
+
+static VnEntry * find(SymbolEntry * s, int op, int a, int b, bool insert)
+{
+	unsigned int i;
+	if (insert && 2 * (tableUsed + 1) > tableSize) growTable();
+	for (i = hashKey(s, op, a, b) & (tableSize - 1); table[i].stamp == stamp; i = (i + 1) & (tableSize - 1))
+		if (table[i].sym == s && table[i].op == op && table[i].a == a && table[i].b == b) return &(table[i]);
+	if (!insert) return NULL;
+	table[i].sym	= s;
+	table[i].op		= op;
+	table[i].a		= a;
+	table[i].b		= b;
+	table[i].vn		= -1;
+	table[i].epoch	= 0;
+	table[i].stamp	= stamp;
+	tableUsed++;
+	return &(table[i]);
+}
+
+static int fresh()
+{
+	if (vnNext == holderSize) {
+		holderSize = (holderSize == 0) ? 256 : 2 * holderSize;
+		holder = (SymbolEntry **) realloc(holder, holderSize * sizeof(SymbolEntry *));
+		if (holder == NULL) fatal("Out of memory");
+	}
+	holder[vnNext] = NULL;
+	return vnNext++;
+}
+
+//value number of s if it is known and still valid, -1 otherwise
+static int peekVn(SymbolEntry * s)
+{
+	VnEntry * e = find(s, VN_SYMBOL, 0, 0, false);
+	if (e == NULL || e->epoch != epochOf(classOf(s))) return -1;
+	return e->vn;
+}
+
+static SymbolEntry * holderOf(int vn)
+{
+	SymbolEntry * h = holder[vn];
+	return (h != NULL && peekVn(h) == vn) ? h : NULL;
+}
+
+//constants are preferred as holders, then temporaries, then locals
+static void setSymbolVn(SymbolEntry * s, int vn)
+{
+	VnEntry * e = find(s, VN_SYMBOL, 0, 0, true);
+	e->vn		= vn;
+	e->epoch	= epochOf(classOf(s));
+	SymbolEntry * h = holderOf(vn);
+	if (h == NULL || classOf(s) < classOf(h)) holder[vn] = s;
+}
+
+static int symbolVn(SymbolEntry * s)
+{
+	int vn = peekVn(s);
+	if (vn < 0) {
+		vn = fresh();
+		setSymbolVn(s, vn);
+	}
+	return vn;
+}
+
+static int operandVn(Operand o)
+{
+	VnEntry * e;
+	int vn;
+	switch (o->type) {
+		case OPERAND_SYMBOL:
+			return symbolVn(o->u.symbol);
+		case OPERAND_DEREFERENCE:
+			vn = symbolVn(o->u.symbol);
+			e = find(NULL, VN_LOAD, vn, 0, true);
+			if (e->vn < 0 || e->epoch != memEpoch) {
+				e->vn		= fresh();
+				e->epoch	= memEpoch;
+			}
+			return e->vn;
+		default:
+			return fresh();		//{x}: never equal to anything
+	}
+}
+
+//a store to [x], a non-local or a parameter by reference may change any of them
+static void store(Operand z, int vn)
+{
+	VnEntry * e;
+	int p;
+	switch (z->type) {
+		case OPERAND_SYMBOL:
+			if (classOf(z->u.symbol) == VN_MEMORY) memEpoch++;
+			setSymbolVn(z->u.symbol, vn);
+			break;
+		case OPERAND_DEREFERENCE:
+			p = symbolVn(z->u.symbol);
+			memEpoch++;
+			e = find(NULL, VN_LOAD, p, 0, true);
+			e->vn		= vn;
+			e->epoch	= memEpoch;
+			break;
+		default:	//$$: the result of the caller, not visible here
+			break;
+	}
+}
+
+static bool sameSize(SymbolEntry * s1, Type t2)
+{
+	return sizeOfType(getType(s1)) == sizeOfType(t2);
+}
+
+//string literals are left to be addressed through the symbols that hold them
+static bool isScalarConst(SymbolEntry * h)
+{
+	return classOf(h) == VN_CONST && getType(h)->kind != TYPE_IARRAY;
+}
+
+/* An operand that is read is replaced by the constant that has its value, a temporary also
+ * by the temporary or local that holds its value. In [t], t is replaced as well */
+static Operand rewrite(Operand o)
+{
+	SymbolEntry * s, * h;
+	Operand r = o;
+	switch (o->type) {
+		case OPERAND_SYMBOL:
+			s = o->u.symbol;
+			if (classOf(s) == VN_CONST) return o;
+			h = holderOf(symbolVn(s));
+			if (h != NULL && h != s && (isScalarConst(h) || (classOf(s) == VN_TEMP && (classOf(h) == VN_TEMP || classOf(h) == VN_LOCAL))) &&
+				sameSize(h, getType(s)))
+				r = oS(h);
+			break;
+		case OPERAND_DEREFERENCE:
+			s = o->u.symbol;
+			h = holderOf(operandVn(o));
+			if (h != NULL && (isScalarConst(h) || classOf(h) == VN_TEMP || classOf(h) == VN_LOCAL) && sameSize(h, getType(s)->refType)) {
+				r = oS(h);
+				break;
+			}
+			if (classOf(s) != VN_TEMP) return o;
+			h = holderOf(symbolVn(s));
+			if (h != NULL && h != s && (classOf(h) == VN_TEMP || classOf(h) == VN_LOCAL) && equalType(getType(h), getType(s)))
+				r = oD(h);
+			break;
+		default:
+			return o;
+	}
+	if (r != o) changed = true;
+	return r;
+}
+
+
+/* -------------------------------------------------------------
+   ------------------------- The pass --------------------------
+   ------------------------------------------------------------- */
+
+static void numberQuad(int i)
+{
+	Quad * p = &(q[i]);
+	VnEntry * e;
+	SymbolEntry * h;
+	int vx, vy, vn;
+	switch (p->op) {
+		case O_ASSIGN:
+			p->x = rewrite(p->x);
+			vx = operandVn(p->x);
+			if (p->z->type == OPERAND_SYMBOL && classOf(p->z->u.symbol) != VN_MEMORY && peekVn(p->z->u.symbol) == vx) {
+				p->num = -1;	//it already holds this value
+				changed = true;
+				#ifdef DEBUG
+				printf("opt: valueNumbering: quad %d removed\n", i);
+				#endif
+				break;
+			}
+			store(p->z, vx);
+			break;
+		case O_ADD: case O_SUB: case O_MULT: case O_DIV: case O_MOD: case O_ARRAY:
+			p->x = rewrite(p->x);
+			p->y = rewrite(p->y);
+			vx = operandVn(p->x);
+			vy = operandVn(p->y);
+			if ((p->op == O_ADD || p->op == O_MULT) && vx > vy) { vn = vx; vx = vy; vy = vn; }
+			e = find(NULL, p->op, vx, vy, false);
+			h = (e != NULL) ? holderOf(e->vn) : NULL;
+			if (h != NULL && (p->z->type != OPERAND_SYMBOL || sameSize(h, getType(p->z->u.symbol))) &&
+				(p->z->type != OPERAND_DEREFERENCE || sameSize(h, getType(p->z->u.symbol)->refType))) {
+				vn = e->vn;
+				p->op	= O_ASSIGN;
+				p->x	= oS(h);
+				p->y	= o_;
+				changed = true;
+				#ifdef DEBUG
+				printf("opt: valueNumbering: quad %d reuses %s\n", i, entryName(h));
+				#endif
+			} else {
+				vn = fresh();
+				find(NULL, p->op, vx, vy, true)->vn = vn;
+			}
+			store(p->z, vn);
+			break;
+		case O_EQ: case O_NE: case O_LT: case O_GT: case O_LE: case O_GE:
+			p->x = rewrite(p->x);
+			p->y = rewrite(p->y);
+			break;
+		case O_IFB:
+			p->x = rewrite(p->x);
+			break;
+		case O_PAR:
+			if (p->y == oV)			p->x = rewrite(p->x);
+			else if (p->y == oRET)	store(p->x, fresh());	//written by the call
+			break;		//by reference: the call may write it
+		case O_CALL:
+			memEpoch++;
+			callEpoch++;
+			break;
+		default:
+			break;
+	}
+}
+
+bool valueNumbering(Cfg g)
+{
+	int b, i;
+	level	= getSymbol(q[g->first].x)->nestingLevel + 1;
+	changed	= false;
+	for (b = 0; b < g->blockNum; b++) {
+		if (!g->block[b].reachable) continue;
+		stamp++;			//forget the previous block
+		if (table == NULL) growTable();
+		tableUsed	= 0;
+		vnNext		= 0;
+		for (i = g->block[b].first; i <= g->block[b].last; i++)
+			if (ISACTIVE(q[i].num)) numberQuad(i);
+	}
+	return changed;
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+ *
+ *  C header file : valnum.h
+ *  Project       : Tony Compiler
+ *  Version       : 1.0 alpha
+ *  Written by    : Manolis	Androulidakis
+ *  Date          : October 18, 2016
+ *  Description   : Local value numbering (common subexpressions in a basic block)
+ *
+ *  ---------
+ *  Εθνικό Μετσόβιο Πολυτεχνείο.
+ *  Σχολή Ηλεκτρολόγων Μηχανικών και Μηχανικών Υπολογιστών.
+ *  Τομέας Τεχνολογίας Πληροφορικής και Υπολογιστών.
+ *  Εργαστήριο Τεχνολογίας Λογισμικού
+ */
+
+
+#ifndef __VALNUM_H__
+#define __VALNUM_H__
+
+#include <stdbool.h>
+
+#include "cfg.h"
+
+/* Every block of the unit is walked once. Equal values get the same number and a quad
+ * that computes again a value (+, -, *, /, mod, array) that some symbol still holds becomes
+ * an assignment from it. Temporaries read are replaced by the symbol that holds their
+ * value and any symbol by a constant, so the copies left are removed as dead temporaries.
+ * Returns whether some quad changed */
+bool	valueNumbering	(Cfg g);
+
+#endif